@@ -0,0 +1,584 @@
+// ---------------------------------------------------------------------------
+// decode.cpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Edge decoding is two passes over the capture:
+//   count: XOR each sample with the one before it and popcount the changes.
+//   find:  XOR again, skip whole vectors with no change, and compact the set
+//          bits of the rest into PinEdge entries.
+// Captures are mostly idle, so nearly all of the work is the vector XOR/test.
+// Every kernel hands changed words to the same scalar compaction, so the
+// output is identical to the scalar reference.
+// ---------------------------------------------------------------------------
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+#if ( defined( __x86_64__ ) || defined( __i386__ )) && defined( __GNUC__ )
+#include <immintrin.h>
+#define DECODE_HAVE_AVX2 1
+#endif
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define DECODE_HAVE_NEON 1
+#endif
+#include "decode.hpp"
+
+
+namespace  tfs {
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Scalar kernels
+// ---------------------------------------------------------------------------
+
+    static inline PinEdge*
+    emit( PinEdge *out, uint32_t changed, uint32_t level, uint64_t sample ) {
+        // Compact the set bits of changed into edges, lowest pin first.
+        while( changed != 0 ) {
+            const int pin = __builtin_ctz( changed );
+            out->sample = sample;
+            out->pin    = static_cast<uint8_t>( pin );
+            out->level  = static_cast<uint8_t>(( level >> pin ) & 1 );
+            out++;
+            changed &= changed - 1;
+        }
+        return out;
+    }
+
+    static size_t
+    countScalar( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask ) {
+        size_t total = 0;
+        for( size_t ii = 0; ii < length; ii++ ) {
+            total   += __builtin_popcount(( samples[ii] ^ previous ) & mask );
+            previous = samples[ii];
+        }
+        return total;
+    }
+
+    static PinEdge*
+    findScalar( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask, uint64_t base, PinEdge *out ) {
+        for( size_t ii = 0; ii < length; ii++ ) {
+            const uint32_t changed = ( samples[ii] ^ previous ) & mask;
+            if( changed != 0 ) {
+                out = emit( out, changed, samples[ii], base + ii );
+            }
+            previous = samples[ii];
+        }
+        return out;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - SSE2 kernels
+// ---------------------------------------------------------------------------
+#if defined( __SSE2__ )
+
+    static size_t
+    countSse2( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask ) {
+        if( length < 5 ) {
+            return countScalar( samples, length, previous, mask );
+        }
+        size_t total = __builtin_popcount(( samples[0] ^ previous ) & mask );
+        const __m128i m55  = _mm_set1_epi8( 0x55 );
+        const __m128i m33  = _mm_set1_epi8( 0x33 );
+        const __m128i m0f  = _mm_set1_epi8( 0x0F );
+        const __m128i vmask = _mm_set1_epi32( static_cast<int>( mask ));
+        __m128i sum = _mm_setzero_si128();
+        size_t ii = 1;
+        for( ; ii + 4 <= length; ii += 4 ) {
+            const __m128i now  = _mm_loadu_si128( reinterpret_cast<const __m128i*>( samples + ii ));
+            const __m128i then = _mm_loadu_si128( reinterpret_cast<const __m128i*>( samples + ii - 1 ));
+            __m128i xx = _mm_and_si128( _mm_xor_si128( now, then ), vmask );
+            xx = _mm_sub_epi8( xx, _mm_and_si128( _mm_srli_epi16( xx, 1 ), m55 ));
+            xx = _mm_add_epi8( _mm_and_si128( xx, m33 ), _mm_and_si128( _mm_srli_epi16( xx, 2 ), m33 ));
+            xx = _mm_and_si128( _mm_add_epi8( xx, _mm_srli_epi16( xx, 4 )), m0f );
+            sum = _mm_add_epi64( sum, _mm_sad_epu8( xx, _mm_setzero_si128()));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( lanes ), sum );
+        total += static_cast<size_t>( lanes[0] + lanes[1] );
+        return total + countScalar( samples + ii, length - ii, samples[ii - 1], mask );
+    }
+
+    static PinEdge*
+    findSse2( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask, uint64_t base, PinEdge *out ) {
+        if( length < 5 ) {
+            return findScalar( samples, length, previous, mask, base, out );
+        }
+        out = findScalar( samples, 1, previous, mask, base, out );
+        const __m128i vmask = _mm_set1_epi32( static_cast<int>( mask ));
+        size_t ii = 1;
+        for( ; ii + 4 <= length; ii += 4 ) {
+            const __m128i now  = _mm_loadu_si128( reinterpret_cast<const __m128i*>( samples + ii ));
+            const __m128i then = _mm_loadu_si128( reinterpret_cast<const __m128i*>( samples + ii - 1 ));
+            const __m128i xx   = _mm_and_si128( _mm_xor_si128( now, then ), vmask );
+            if( _mm_movemask_epi8( _mm_cmpeq_epi32( xx, _mm_setzero_si128())) != 0xFFFF ) {
+                out = findScalar( samples + ii, 4, samples[ii - 1], mask, base + ii, out );
+            }
+        }
+        return findScalar( samples + ii, length - ii, samples[ii - 1], mask, base + ii, out );
+    }
+
+#endif // __SSE2__
+
+// ---------------------------------------------------------------------------
+// #pragma mark - AVX2 kernels, compiled for AVX2 and used only when the CPU has it
+// ---------------------------------------------------------------------------
+#if defined( DECODE_HAVE_AVX2 )
+
+    __attribute__(( target( "avx2" )))
+    static size_t
+    countAvx2( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask ) {
+        if( length < 9 ) {
+            return countScalar( samples, length, previous, mask );
+        }
+        size_t total = __builtin_popcount(( samples[0] ^ previous ) & mask );
+        const __m256i table = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+        const __m256i m0f   = _mm256_set1_epi8( 0x0F );
+        const __m256i vmask = _mm256_set1_epi32( static_cast<int>( mask ));
+        __m256i sum = _mm256_setzero_si256();
+        size_t ii = 1;
+        for( ; ii + 8 <= length; ii += 8 ) {
+            const __m256i now  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( samples + ii ));
+            const __m256i then = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( samples + ii - 1 ));
+            const __m256i xx   = _mm256_and_si256( _mm256_xor_si256( now, then ), vmask );
+            const __m256i lo   = _mm256_shuffle_epi8( table, _mm256_and_si256( xx, m0f ));
+            const __m256i hi   = _mm256_shuffle_epi8( table, _mm256_and_si256( _mm256_srli_epi16( xx, 4 ), m0f ));
+            sum = _mm256_add_epi64( sum, _mm256_sad_epu8( _mm256_add_epi8( lo, hi ), _mm256_setzero_si256()));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( lanes ), sum );
+        total += static_cast<size_t>( lanes[0] + lanes[1] + lanes[2] + lanes[3] );
+        return total + countScalar( samples + ii, length - ii, samples[ii - 1], mask );
+    }
+
+    __attribute__(( target( "avx2" )))
+    static PinEdge*
+    findAvx2( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask, uint64_t base, PinEdge *out ) {
+        if( length < 9 ) {
+            return findScalar( samples, length, previous, mask, base, out );
+        }
+        out = findScalar( samples, 1, previous, mask, base, out );
+        const __m256i vmask = _mm256_set1_epi32( static_cast<int>( mask ));
+        size_t ii = 1;
+        for( ; ii + 8 <= length; ii += 8 ) {
+            const __m256i now  = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( samples + ii ));
+            const __m256i then = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( samples + ii - 1 ));
+            const __m256i xx   = _mm256_and_si256( _mm256_xor_si256( now, then ), vmask );
+            if( !_mm256_testz_si256( xx, xx )) {
+                out = findScalar( samples + ii, 8, samples[ii - 1], mask, base + ii, out );
+            }
+        }
+        return findScalar( samples + ii, length - ii, samples[ii - 1], mask, base + ii, out );
+    }
+
+#endif // DECODE_HAVE_AVX2
+
+// ---------------------------------------------------------------------------
+// #pragma mark - NEON kernels
+// ---------------------------------------------------------------------------
+#if defined( DECODE_HAVE_NEON )
+
+    static size_t
+    countNeon( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask ) {
+        if( length < 5 ) {
+            return countScalar( samples, length, previous, mask );
+        }
+        size_t total = __builtin_popcount(( samples[0] ^ previous ) & mask );
+        const uint32x4_t vmask = vdupq_n_u32( mask );
+        uint64x2_t sum = vdupq_n_u64( 0 );
+        size_t ii = 1;
+        for( ; ii + 4 <= length; ii += 4 ) {
+            const uint32x4_t now  = vld1q_u32( samples + ii );
+            const uint32x4_t then = vld1q_u32( samples + ii - 1 );
+            const uint8x16_t bits = vcntq_u8( vreinterpretq_u8_u32( vandq_u32( veorq_u32( now, then ), vmask )));
+            sum = vaddq_u64( sum, vpaddlq_u32( vpaddlq_u16( vpaddlq_u8( bits ))));
+        }
+        total += static_cast<size_t>( vgetq_lane_u64( sum, 0 ) + vgetq_lane_u64( sum, 1 ));
+        return total + countScalar( samples + ii, length - ii, samples[ii - 1], mask );
+    }
+
+    static PinEdge*
+    findNeon( const uint32_t *samples, size_t length, uint32_t previous, uint32_t mask, uint64_t base, PinEdge *out ) {
+        if( length < 5 ) {
+            return findScalar( samples, length, previous, mask, base, out );
+        }
+        out = findScalar( samples, 1, previous, mask, base, out );
+        const uint32x4_t vmask = vdupq_n_u32( mask );
+        size_t ii = 1;
+        for( ; ii + 4 <= length; ii += 4 ) {
+            const uint32x4_t now  = vld1q_u32( samples + ii );
+            const uint32x4_t then = vld1q_u32( samples + ii - 1 );
+            const uint32x4_t xx   = vandq_u32( veorq_u32( now, then ), vmask );
+            const uint32x2_t any  = vorr_u32( vget_low_u32( xx ), vget_high_u32( xx ));
+            if(( vget_lane_u32( any, 0 ) | vget_lane_u32( any, 1 )) != 0 ) {
+                out = findScalar( samples + ii, 4, samples[ii - 1], mask, base + ii, out );
+            }
+        }
+        return findScalar( samples + ii, length - ii, samples[ii - 1], mask, base + ii, out );
+    }
+
+#endif // DECODE_HAVE_NEON
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Edge decoder
+// ---------------------------------------------------------------------------
+
+    EdgeDecoder::EdgeDecoder( uint32_t pinMask, DECODE_KERNEL kernel ):
+    m_kernel( supported( kernel ) ? kernel : bestKernel()),
+    m_mask( pinMask ),
+    m_previous( 0 ),
+    m_initial( 0 ),
+    m_sample( 0 ),
+    m_primed( false ) {
+        if( m_kernel == DECODE_AUTO ) {
+            m_kernel = bestKernel();
+        }
+    }
+
+    void
+    EdgeDecoder::reset( void ) {
+        m_previous = 0;
+        m_initial  = 0;
+        m_sample   = 0;
+        m_primed   = false;
+    }
+
+    uint32_t
+    EdgeDecoder::getInitialLevels( void ) const {
+        return m_initial;
+    }
+
+    uint64_t
+    EdgeDecoder::getSampleCount( void ) const {
+        return m_sample;
+    }
+
+    DECODE_KERNEL
+    EdgeDecoder::getKernel( void ) const {
+        return m_kernel;
+    }
+
+    DECODE_KERNEL
+    EdgeDecoder::bestKernel( void ) {
+        if( supported( DECODE_AVX2 )) {
+            return DECODE_AVX2;
+        }
+        if( supported( DECODE_NEON )) {
+            return DECODE_NEON;
+        }
+        if( supported( DECODE_SSE2 )) {
+            return DECODE_SSE2;
+        }
+        return DECODE_SCALAR;
+    }
+
+    bool
+    EdgeDecoder::supported( DECODE_KERNEL kernel ) {
+        switch( kernel ) {
+            case DECODE_AUTO:
+            case DECODE_SCALAR:
+                return true;
+            case DECODE_SSE2:
+#if defined( __SSE2__ )
+                return true;
+#else
+                return false;
+#endif
+            case DECODE_AVX2:
+#if defined( DECODE_HAVE_AVX2 )
+                return __builtin_cpu_supports( "avx2" );
+#else
+                return false;
+#endif
+            case DECODE_NEON:
+#if defined( DECODE_HAVE_NEON )
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    const char*
+    EdgeDecoder::name( DECODE_KERNEL kernel ) {
+        switch( kernel ) {
+            case DECODE_AUTO:   return "auto";
+            case DECODE_SCALAR: return "scalar";
+            case DECODE_SSE2:   return "sse2";
+            case DECODE_AVX2:   return "avx2";
+            case DECODE_NEON:   return "neon";
+        }
+        return "unknown";
+    }
+
+    size_t
+    EdgeDecoder::count( const uint32_t *samples, size_t length ) const {
+        if( samples == 0 || length == 0 ) {
+            return 0;
+        }
+        const uint32_t previous = m_primed ? m_previous : samples[0];
+        switch( m_kernel ) {
+#if defined( __SSE2__ )
+            case DECODE_SSE2: return countSse2( samples, length, previous, m_mask );
+#endif
+#if defined( DECODE_HAVE_AVX2 )
+            case DECODE_AVX2: return countAvx2( samples, length, previous, m_mask );
+#endif
+#if defined( DECODE_HAVE_NEON )
+            case DECODE_NEON: return countNeon( samples, length, previous, m_mask );
+#endif
+            default:          return countScalar( samples, length, previous, m_mask );
+        }
+    }
+
+    size_t
+    EdgeDecoder::decode( const uint32_t *samples, size_t length, std::vector<PinEdge> &edges ) {
+        // ---------------------------------------------------------------------------
+        // Count the edges first, so the output is sized once and the find pass
+        // writes straight into it.
+        // ---------------------------------------------------------------------------
+        if( samples == 0 || length == 0 ) {
+            return 0;
+        }
+        if( !m_primed ) {
+            m_initial  = samples[0];
+            m_previous = samples[0];
+            m_primed   = true;
+        }
+        const size_t total = count( samples, length );
+        const size_t start = edges.size();
+        edges.resize( start + total );
+        PinEdge *out = total > 0 ? &edges[start] : 0;
+        if( total > 0 ) {
+            switch( m_kernel ) {
+#if defined( __SSE2__ )
+                case DECODE_SSE2: findSse2( samples, length, m_previous, m_mask, m_sample, out ); break;
+#endif
+#if defined( DECODE_HAVE_AVX2 )
+                case DECODE_AVX2: findAvx2( samples, length, m_previous, m_mask, m_sample, out ); break;
+#endif
+#if defined( DECODE_HAVE_NEON )
+                case DECODE_NEON: findNeon( samples, length, m_previous, m_mask, m_sample, out ); break;
+#endif
+                default:          findScalar( samples, length, m_previous, m_mask, m_sample, out );
+            }
+        }
+        m_previous = samples[length - 1];
+        m_sample  += length;
+        return total;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Protocol decoders
+// ---------------------------------------------------------------------------
+
+    static inline uint32_t
+    bit( uint32_t levels, int pin ) {
+        return ( levels >> pin ) & 1;
+    }
+
+    static inline uint32_t
+    apply( uint32_t levels, const PinEdge &edge ) {
+        return ( levels & ~( 1u << edge.pin )) | ( static_cast<uint32_t>( edge.level ) << edge.pin );
+    }
+
+    UartDecoder::UartDecoder( GPIO_ID rx, double samplesPerBit ):
+    m_rx( rx ),
+    m_samplesPerBit( samplesPerBit ),
+    m_level( 1 ) {
+    }
+
+    void
+    UartDecoder::reset( uint32_t initialLevels ) {
+        m_level = bit( initialLevels, m_rx );
+        m_pending.clear();
+    }
+
+    size_t
+    UartDecoder::decode( const std::vector<PinEdge> &edges, uint64_t endSample, std::vector<UartFrame> &frames ) {
+        // ---------------------------------------------------------------------------
+        // Find each start bit (falling edge) that is still low half a bit later,
+        // then sample the line in the middle of the eight data bits and the stop
+        // bit. A start bit whose stop bit is at or past endSample is kept, with
+        // the edges after it, for the next call.
+        // Returns the number of frames appended.
+        // ---------------------------------------------------------------------------
+        if( m_samplesPerBit < 1.0 ) {
+            return 0;
+        }
+        for( size_t ii = 0; ii < edges.size(); ii++ ) {
+            if( edges[ii].pin == m_rx ) {
+                m_pending.push_back( edges[ii] );
+            }
+        }
+        const size_t count = m_pending.size();
+        const size_t start = frames.size();
+        uint32_t level = m_level;
+        size_t   pos   = 0;
+        while( pos < count ) {
+            const uint32_t before = level;
+            const size_t   first  = pos;
+            const PinEdge &edge   = m_pending[pos++];
+            level = edge.level;
+            if( level != 0 ) {
+                continue;
+            }
+            const uint64_t stopMiddle = edge.sample + static_cast<uint64_t>( 9.5 * m_samplesPerBit );
+            if( stopMiddle >= endSample ) {
+                m_pending.erase( m_pending.begin(), m_pending.begin() + first );
+                m_level = before;
+                return frames.size() - start;
+            }
+            UartFrame frame;
+            frame.sample       = edge.sample;
+            frame.data         = 0;
+            frame.framingError = false;
+            bool glitch = false;
+            for( int ii = -1; ii < 9 && !glitch; ii++ ) {
+                // Advance the line level to the middle of bit ii, -1 being the start bit.
+                const uint64_t middle = edge.sample + static_cast<uint64_t>(( 1.5 + ii ) * m_samplesPerBit );
+                while( pos < count && m_pending[pos].sample <= middle ) {
+                    level = m_pending[pos++].level;
+                }
+                if( ii < 0 ) {
+                    glitch = level != 0;
+                } else if( ii < 8 ) {
+                    frame.data |= static_cast<uint8_t>( level << ii );
+                } else {
+                    frame.framingError = level == 0;
+                }
+            }
+            if( !glitch ) {
+                frames.push_back( frame );
+            }
+        }
+        m_pending.clear();
+        m_level = level;
+        return frames.size() - start;
+    }
+
+    size_t
+    decodeUart( const std::vector<PinEdge> &edges, uint32_t initialLevels, GPIO_ID rx,
+                double samplesPerBit, uint64_t endSample, std::vector<UartFrame> &frames ) {
+        UartDecoder decoder( rx, samplesPerBit );
+        decoder.reset( initialLevels );
+        return decoder.decode( edges, endSample, frames );
+    }
+
+    size_t
+    decodeSpi( const std::vector<PinEdge> &edges, uint32_t initialLevels,
+               GPIO_ID sclk, GPIO_ID mosi, GPIO_ID miso, GPIO_ID cs, int mode,
+               std::vector<SpiFrame> &frames ) {
+        // ---------------------------------------------------------------------------
+        // Edges that share a sample are applied together. Data lines are read
+        // from the levels before that sample, as the slave or master would
+        // have set them up ahead of the sampling clock edge.
+        // Returns the number of frames appended.
+        // ---------------------------------------------------------------------------
+        const uint32_t sampleLevel = (( mode >> 1 ) & 1 ) == ( mode & 1 ) ? 1 : 0;    // Rising for modes 0 & 3.
+        const size_t   count       = edges.size();
+        const size_t   start       = frames.size();
+        uint32_t levels = initialLevels;
+        SpiFrame frame;
+        frame.sample = 0;
+        frame.mosi   = 0;
+        frame.miso   = 0;
+        int      bits = 0;
+        size_t   pos  = 0;
+        while( pos < count ) {
+            const uint64_t sample = edges[pos].sample;
+            const uint32_t before = levels;
+            bool clocked  = false;
+            bool selected = false;
+            for( ; pos < count && edges[pos].sample == sample; pos++ ) {
+                levels = apply( levels, edges[pos] );
+                if( edges[pos].pin == sclk && edges[pos].level == sampleLevel ) {
+                    clocked = true;
+                } else if( edges[pos].pin == cs ) {
+                    selected = true;
+                }
+            }
+            if( selected ) {
+                bits = 0;               // Any partial byte is dropped when chip select changes.
+            }
+            if( !clocked || bit( levels, cs ) != 0 || bit( before, cs ) != 0 ) {
+                continue;
+            }
+            if( bits == 0 ) {
+                frame.sample = sample;
+                frame.mosi   = 0;
+                frame.miso   = 0;
+            }
+            frame.mosi = static_cast<uint8_t>(( frame.mosi << 1 ) | bit( before, mosi ));
+            frame.miso = static_cast<uint8_t>(( frame.miso << 1 ) | bit( before, miso ));
+            if( ++bits == 8 ) {
+                frames.push_back( frame );
+                bits = 0;
+            }
+        }
+        return frames.size() - start;
+    }
+
+    size_t
+    decodeI2c( const std::vector<PinEdge> &edges, uint32_t initialLevels,
+               GPIO_ID sda, GPIO_ID scl, std::vector<I2cFrame> &frames ) {
+        // ---------------------------------------------------------------------------
+        // START and STOP are SDA changes while SCL stays high. Between them each
+        // rising SCL clocks one bit: eight data bits then the ack bit.
+        // Returns the number of frames appended.
+        // ---------------------------------------------------------------------------
+        const size_t count = edges.size();
+        const size_t start = frames.size();
+        uint32_t levels = initialLevels;
+        bool     active = false;
+        int      bits   = 0;
+        I2cFrame frame;
+        frame.sample = 0;
+        frame.event  = I2C_EVENT_BYTE;
+        frame.data   = 0;
+        frame.ack    = false;
+        size_t   pos = 0;
+        while( pos < count ) {
+            const uint64_t sample = edges[pos].sample;
+            const uint32_t before = levels;
+            for( ; pos < count && edges[pos].sample == sample; pos++ ) {
+                levels = apply( levels, edges[pos] );
+            }
+            const bool sclHigh = bit( before, scl ) != 0 && bit( levels, scl ) != 0;
+            const bool sclRise = bit( before, scl ) == 0 && bit( levels, scl ) != 0;
+            if( sclHigh && bit( before, sda ) != bit( levels, sda )) {
+                I2cFrame event;
+                event.sample = sample;
+                event.event  = bit( levels, sda ) == 0 ? I2C_EVENT_START : I2C_EVENT_STOP;
+                event.data   = 0;
+                event.ack    = false;
+                frames.push_back( event );
+                active = event.event == I2C_EVENT_START;
+                bits   = 0;
+                continue;
+            }
+            if( !sclRise || !active ) {
+                continue;
+            }
+            if( bits == 0 ) {
+                frame.sample = sample;
+                frame.data   = 0;
+            }
+            if( bits < 8 ) {
+                frame.data = static_cast<uint8_t>(( frame.data << 1 ) | bit( before, sda ));
+                bits++;
+            } else {
+                frame.ack = bit( before, sda ) == 0;
+                frames.push_back( frame );
+                bits = 0;
+            }
+        }
+        return frames.size() - start;
+    }
+
+}   // namespace tfs
@@ -0,0 +1,136 @@
+// ---------------------------------------------------------------------------
+// decode.hpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Decoding of captured pin samples.
+//
+// A capture is an array of 32 bit words, one per sample, with bit N holding
+// the level of GPIO N (the layout of the BCM283x GPLEV0 register.)
+// EdgeDecoder turns a capture into a list of edges, and the protocol decoders
+// turn an edge list into UART, SPI or I2C frames.
+//
+// Timestamps are sample numbers. Multiply by the sample period for time.
+// ---------------------------------------------------------------------------
+#ifndef decode_hpp
+#define decode_hpp
+
+#include <stdint.h>
+#include <vector>
+#include "gpio.hpp"             // GPIO_ID
+
+namespace  tfs {
+
+    enum DECODE_KERNEL {
+        DECODE_AUTO = 0,        // Fastest kernel this CPU supports.
+        DECODE_SCALAR,          // Portable reference.
+        DECODE_SSE2,            // x86
+        DECODE_AVX2,            // x86, chosen at run time when the CPU supports it.
+        DECODE_NEON             // ARM, when built with NEON enabled. e.g. -mfpu=neon
+    };
+
+    struct PinEdge {
+        uint64_t    sample;     // Sample number of the first sample at the new level.
+        uint8_t     pin;        // Broadcom GPIO number.
+        uint8_t     level;      // New level, 1 for rising, 0 for falling.
+    };
+
+    class EdgeDecoder {
+    protected:
+        DECODE_KERNEL   m_kernel;
+        uint32_t        m_mask;         // Pins to decode.
+        uint32_t        m_previous;     // Last sample seen.
+        uint32_t        m_initial;      // First sample seen, the levels before any edge.
+        uint64_t        m_sample;       // Sample number of the next sample.
+        bool            m_primed;       // m_previous is valid.
+
+    public:
+        EdgeDecoder( uint32_t pinMask = 0xFFFFFFFF, DECODE_KERNEL kernel = DECODE_AUTO );
+
+        // -------------------------------------------------------------------
+        // Append the edges in samples to edges, in sample order and then pin
+        // order. Consecutive calls continue one capture, so edges between the
+        // last sample of one call and the first of the next are found.
+        // Returns the number of edges appended.
+        // -------------------------------------------------------------------
+        size_t decode( const uint32_t *samples, size_t length, std::vector<PinEdge> &edges );
+        size_t count(  const uint32_t *samples, size_t length ) const; // Edges decode() would find, without state change.
+
+        void     reset( void );                 // Start a new capture.
+        uint32_t getInitialLevels( void ) const;
+        uint64_t getSampleCount(   void ) const;
+        DECODE_KERNEL getKernel(   void ) const;
+
+        static DECODE_KERNEL bestKernel( void );
+        static bool          supported( DECODE_KERNEL kernel );
+        static const char   *name(      DECODE_KERNEL kernel );
+    };
+
+    // -----------------------------------------------------------------------
+    // Protocol decoders. Each takes the levels before the first edge, as from
+    // EdgeDecoder::getInitialLevels(), and an edge list in decode() order.
+    // -----------------------------------------------------------------------
+
+    struct UartFrame {
+        uint64_t    sample;     // Start bit.
+        uint8_t     data;
+        bool        framingError;   // Stop bit was low.
+    };
+
+    struct SpiFrame {
+        uint64_t    sample;     // First clock edge of the byte.
+        uint8_t     mosi;
+        uint8_t     miso;
+    };
+
+    enum I2C_EVENT {
+        I2C_EVENT_START = 0,    // Also repeated start.
+        I2C_EVENT_STOP,
+        I2C_EVENT_BYTE          // Address or data byte, then the ack bit.
+    };
+
+    struct I2cFrame {
+        uint64_t    sample;
+        I2C_EVENT   event;
+        uint8_t     data;       // I2C_EVENT_BYTE only.
+        bool        ack;        // I2C_EVENT_BYTE only, true when the receiver pulled SDA low.
+    };
+
+    // -----------------------------------------------------------------------
+    // 8N1, idle high, least significant bit first. samplesPerBit = sample rate / baud.
+    // endSample is the number of samples captured, EdgeDecoder::getSampleCount().
+    // A start bit must still be low in its middle, and a frame is only decoded
+    // once its stop bit is inside the capture. UartDecoder holds an unfinished
+    // frame back for the next call, so a capture can be decoded in chunks.
+    // -----------------------------------------------------------------------
+    class UartDecoder {
+    protected:
+        GPIO_ID     m_rx;
+        double      m_samplesPerBit;
+        uint32_t    m_level;            // Line level before m_pending[0].
+        std::vector<PinEdge> m_pending; // rx edges not yet decoded, from an unfinished start bit on.
+
+    public:
+        UartDecoder( GPIO_ID rx, double samplesPerBit );
+
+        void   reset( uint32_t initialLevels );    // Start a new capture.
+        size_t decode( const std::vector<PinEdge> &edges, uint64_t endSample, std::vector<UartFrame> &frames );
+    };
+
+    size_t decodeUart( const std::vector<PinEdge> &edges, uint32_t initialLevels, GPIO_ID rx,
+                       double samplesPerBit, uint64_t endSample, std::vector<UartFrame> &frames );
+
+    // Most significant bit first, chip select active low. mode is SPI mode 0 .. 3.
+    size_t decodeSpi( const std::vector<PinEdge> &edges, uint32_t initialLevels,
+                      GPIO_ID sclk, GPIO_ID mosi, GPIO_ID miso, GPIO_ID cs, int mode,
+                      std::vector<SpiFrame> &frames );
+
+    size_t decodeI2c( const std::vector<PinEdge> &edges, uint32_t initialLevels,
+                      GPIO_ID sda, GPIO_ID scl, std::vector<I2cFrame> &frames );
+
+}   // namespace tfs
+
+#endif // decode_hpp
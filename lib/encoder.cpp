@@ -0,0 +1,552 @@
+// ---------------------------------------------------------------------------
+// encoder.cpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Quadrature decoding with a 16 entry table indexed by (old state << 2) | new state.
+// Edges that share a timestamp are applied together, so A and B changing at
+// once is seen as the illegal transition that it is, rather than as two steps.
+// Counts are kept in locals while a batch is processed and published to the
+// atomics once at the end of the batch.
+//
+// EdgeReader uses the GPIO character device uAPI v2 (Linux 5.10 and later.)
+// The kernel timestamps each edge in its interrupt handler and queues it, so
+// a burst of edges is read back in one read() rather than one wakeup each.
+// On the Pi, line offsets on /dev/gpiochip0 are the Broadcom GPIO numbers.
+// ---------------------------------------------------------------------------
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include "encoder.hpp"
+
+
+namespace  tfs {
+
+    static const int ILLEGAL = 2;
+
+    static const int QUADRATURE_TABLE[16] = {
+    //  new:  00       01       10       11          old:
+              0,      -1,      +1,      ILLEGAL,    // 00
+             +1,       0,       ILLEGAL, -1,        // 01
+             -1,       ILLEGAL, 0,      +1,         // 10
+              ILLEGAL, +1,     -1,       0          // 11
+    };
+
+    static const int    CLOSED_FD       = -1;
+    static const size_t EVENT_SIZE      = sizeof( struct gpio_v2_line_event );
+    static const size_t EVENTS_PER_READ = 64;
+
+    static uint64_t nanoseconds( void ) {
+        struct timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return static_cast<uint64_t>( now.tv_sec ) * 1000000000ull + now.tv_nsec;
+    }
+
+    static double perSecond( uint64_t interval, uint64_t countTime, uint64_t seenTime ) {
+        // ---------------------------------------------------------------------------
+        // Events per second from the last interval, or from the time since the
+        // last event once that is longer, so a stopped input falls towards 0.
+        // ---------------------------------------------------------------------------
+        if( interval == 0 ) {
+            return 0.0;
+        }
+        const uint64_t since = seenTime > countTime ? seenTime - countTime : 0;
+        return 1.0e9 / static_cast<double>( since > interval ? since : interval );
+    }
+
+    static void publishLater( std::atomic<uint64_t> &time, uint64_t nanoseconds ) {
+        // Only the feeding thread stores, so a plain compare is enough.
+        if( nanoseconds > time.load( std::memory_order_relaxed )) {
+            time.store( nanoseconds, std::memory_order_relaxed );
+        }
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Edge reader
+// ---------------------------------------------------------------------------
+
+    EdgeReader::EdgeReader( void ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_initial( 0 ),
+    m_sequence( 0 ),
+    m_primed( false ),
+    m_dropped( 0 ),
+    m_buffer( EVENT_SIZE * EVENTS_PER_READ ) {
+    }
+
+    EdgeReader::EdgeReader( const GPIO_ID *pins, size_t count, EDGE edge, int chip, size_t queueLength ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_initial( 0 ),
+    m_sequence( 0 ),
+    m_primed( false ),
+    m_dropped( 0 ),
+    m_buffer( EVENT_SIZE * EVENTS_PER_READ ) {
+        if( pins == 0 || count == 0 || count > GPIO_V2_LINES_MAX || edge == EDGE_NONE ) {
+            setStatus( STATUS_INTERNAL_BAD_ARG );
+            return;
+        }
+        std::stringstream path;
+        path << "/dev/gpiochip" << chip;
+        const int chipFd = ::open( path.str().c_str(), O_RDONLY );
+        if( chipFd < 0 ) {
+            setStatus( STATUS_ERROR_FILE_OPEN );
+            return;
+        }
+        struct gpio_v2_line_request request;
+        memset( &request, 0, sizeof( request ));
+        for( size_t ii = 0; ii < count; ii++ ) {
+            request.offsets[ii] = pins[ii];
+            m_pins.push_back( pins[ii] );
+        }
+        strncpy( request.consumer, "pi_lib", GPIO_MAX_NAME_SIZE - 1 );
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+        if( edge != EDGE_FALLING ) {
+            request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+        }
+        if( edge != EDGE_RISING ) {
+            request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+        }
+        request.num_lines         = static_cast<uint32_t>( count );
+        request.event_buffer_size = static_cast<uint32_t>( queueLength );
+        const int result = ioctl( chipFd, GPIO_V2_GET_LINE_IOCTL, &request );
+        ::close( chipFd );
+        if( result < 0 ) {
+            setStatus( STATUS_ERROR_IOCTL );
+            return;
+        }
+        m_fd = request.fd;
+
+        struct gpio_v2_line_values values;
+        values.bits = 0;
+        values.mask = count == 64 ? ~0ull : ( 1ull << count ) - 1;
+        if( ioctl( m_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values ) < 0 ) {
+            setStatus( STATUS_ERROR_IOCTL );
+            return;
+        }
+        for( size_t ii = 0; ii < count; ii++ ) {
+            if(( values.bits >> ii ) & 1 ) {
+                m_initial |= 1u << pins[ii];
+            }
+        }
+        fcntl( m_fd, F_SETFL, O_NONBLOCK );
+    }
+
+    EdgeReader::~EdgeReader( void ) {
+        if( m_fd >= 0 ) {
+            ::close( m_fd );
+        }
+    }
+
+    bool
+    EdgeReader::read( std::vector<PinEdge> &edges, long milliseconds ) {
+        // ---------------------------------------------------------------------------
+        // One wakeup, then as many read()s as it takes to empty the kernel queue.
+        // Gaps in the event sequence numbers are edges the kernel had to drop.
+        // ---------------------------------------------------------------------------
+        if( m_fd < 0 ) {
+            return setStatus( STATUS_ERROR_FILE_OPEN );
+        }
+        struct pollfd fd;
+        fd.fd      = m_fd;
+        fd.events  = POLLIN;
+        fd.revents = 0;
+        const int rc = ::poll( &fd, 1, static_cast<int>( milliseconds ));
+        if( rc < 0 && errno != EINTR ) {
+            return setStatus( STATUS_ERROR_FILE_READ );
+        }
+        if( rc <= 0 ) {
+            return setStatus( STATUS_TIMEOUT );
+        }
+        const size_t before = edges.size();
+        while( true ) {
+            const ssize_t length = ::read( m_fd, &m_buffer[0], m_buffer.size());
+            if( length < 0 ) {
+                if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+                    break;
+                }
+                return setStatus( STATUS_ERROR_FILE_READ );
+            }
+            const size_t events = static_cast<size_t>( length ) / EVENT_SIZE;
+            for( size_t ii = 0; ii < events; ii++ ) {
+                struct gpio_v2_line_event event;
+                memcpy( &event, &m_buffer[ii * EVENT_SIZE], EVENT_SIZE );
+                if( m_primed && event.seqno != m_sequence + 1 ) {
+                    m_dropped += event.seqno - m_sequence - 1;
+                }
+                m_sequence = event.seqno;
+                m_primed   = true;
+                PinEdge edge;
+                edge.sample = event.timestamp_ns;
+                edge.pin    = static_cast<uint8_t>( event.offset );
+                edge.level  = event.id == GPIO_V2_LINE_EVENT_RISING_EDGE ? 1 : 0;
+                edges.push_back( edge );
+            }
+            if( static_cast<size_t>( length ) < m_buffer.size()) {
+                break;                      // Queue is empty.
+            }
+        }
+        return setStatus( edges.size() > before ? STATUS_OK : STATUS_TIMEOUT );
+    }
+
+    uint32_t
+    EdgeReader::getInitialLevels( void ) const {
+        return m_initial;
+    }
+
+    uint64_t
+    EdgeReader::getDropped( void ) const {
+        return m_dropped;
+    }
+
+    int
+    EdgeReader::getFileDescriptor( void ) const {
+        return m_fd;
+    }
+
+    bool
+    EdgeReader::setStatus( STATUS status ) {
+        m_status = status;
+        return m_status == STATUS_OK;
+    }
+
+    STATUS
+    EdgeReader::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    EdgeReader::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    EdgeReader::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Quadrature encoder
+// ---------------------------------------------------------------------------
+
+    QuadratureEncoder::QuadratureEncoder( GPIO_ID a, GPIO_ID b ):
+    m_a( a ),
+    m_b( b ),
+    m_period( 1.0 ),
+    m_state( 0 ),
+    m_lastTime( 0 ),
+    m_primed( false ),
+    m_count( 0 ),
+    m_errors( 0 ),
+    m_transitions( 0 ),
+    m_interval( 0 ),
+    m_countTime( 0 ),
+    m_seenTime( 0 ) {
+    }
+
+    void
+    QuadratureEncoder::setSamplePeriod( double nanoseconds ) {
+        if( nanoseconds > 0.0 ) {
+            m_period = nanoseconds;
+        }
+    }
+
+    void
+    QuadratureEncoder::reset( uint32_t initialLevels ) {
+        m_state    = ((( initialLevels >> m_a ) & 1 ) << 1 ) | (( initialLevels >> m_b ) & 1 );
+        m_lastTime = 0;
+        m_primed   = false;
+        m_count.store( 0 );
+        m_errors.store( 0 );
+        m_transitions.store( 0 );
+        m_interval.store( 0 );
+        m_countTime.store( 0 );
+        m_seenTime.store( 0 );
+    }
+
+    void
+    QuadratureEncoder::transition( uint32_t state, uint64_t nanoseconds, int64_t &count, uint64_t &errors, uint64_t &transitions, int64_t &interval ) {
+        const int delta = QUADRATURE_TABLE[( m_state << 2 ) | state];
+        m_state = state;
+        if( delta == ILLEGAL ) {
+            errors++;
+            return;
+        }
+        if( delta == 0 ) {
+            return;
+        }
+        count += delta;
+        transitions++;
+        if( m_primed ) {
+            const int64_t elapsed = static_cast<int64_t>( nanoseconds - m_lastTime );
+            interval = delta > 0 ? elapsed : -elapsed;
+        }
+        m_lastTime = nanoseconds;
+        m_primed   = true;
+    }
+
+    size_t
+    QuadratureEncoder::process( const PinEdge *edges, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Decode a batch of edges, in timestamp order. Edges for other pins are skipped.
+        // Returns the number of edges that were for A or B.
+        // ---------------------------------------------------------------------------
+        if( edges == 0 ) {
+            return 0;
+        }
+        int64_t  position    = m_count.load( std::memory_order_relaxed );
+        uint64_t errors      = m_errors.load( std::memory_order_relaxed );
+        uint64_t transitions = m_transitions.load( std::memory_order_relaxed );
+        int64_t  interval    = 0;
+        size_t   used        = 0;
+        size_t   pos         = 0;
+        while( pos < count ) {
+            const uint64_t sample = edges[pos].sample;
+            uint32_t state = m_state;
+            bool     seen  = false;
+            for( ; pos < count && edges[pos].sample == sample; pos++ ) {
+                const PinEdge &edge = edges[pos];
+                uint32_t mask;
+                if( edge.pin == m_a ) {
+                    mask = 2;
+                } else if( edge.pin == m_b ) {
+                    mask = 1;
+                } else {
+                    continue;
+                }
+                if((( state & mask ) != 0 ) == ( edge.level != 0 )) {
+                    errors++;               // Already at this level, the opposite edge was missed.
+                }
+                state = edge.level != 0 ? ( state | mask ) : ( state & ~mask );
+                seen  = true;
+                used++;
+            }
+            if( seen ) {
+                transition( state, static_cast<uint64_t>( sample * m_period ), position, errors, transitions, interval );
+            }
+        }
+        if( interval != 0 ) {
+            m_interval.store( interval, std::memory_order_relaxed );
+        }
+        if( m_primed ) {
+            m_countTime.store( m_lastTime, std::memory_order_relaxed );
+        }
+        if( count > 0 ) {
+            publishLater( m_seenTime, static_cast<uint64_t>( edges[count - 1].sample * m_period ));
+        }
+        m_errors.store(      errors,      std::memory_order_relaxed );
+        m_transitions.store( transitions, std::memory_order_relaxed );
+        m_count.store(       position,    std::memory_order_release );
+        return used;
+    }
+
+    bool
+    QuadratureEncoder::poll( GpioInput &a, GpioInput &b ) {
+        // ---------------------------------------------------------------------------
+        // Read both pins and count the change since the last call, if any.
+        // Only suitable for low rates: more than one step between polls is an error.
+        // Returns true for success, false if a pin could not be read.
+        // ---------------------------------------------------------------------------
+        bool levelA, levelB;
+        if( !a.read( levelA ) || !b.read( levelB )) {
+            return false;
+        }
+        const uint64_t sample = static_cast<uint64_t>( nanoseconds() / m_period );
+        PinEdge edges[2];
+        size_t  count = 0;
+        if((( m_state & 2 ) != 0 ) != levelA ) {
+            edges[count].sample = sample;
+            edges[count].pin    = static_cast<uint8_t>( m_a );
+            edges[count].level  = levelA ? 1 : 0;
+            count++;
+        }
+        if((( m_state & 1 ) != 0 ) != levelB ) {
+            edges[count].sample = sample;
+            edges[count].pin    = static_cast<uint8_t>( m_b );
+            edges[count].level  = levelB ? 1 : 0;
+            count++;
+        }
+        process( edges, count );
+        advance( sample );
+        return true;
+    }
+
+    void
+    QuadratureEncoder::advance( uint64_t sample ) {
+        publishLater( m_seenTime, static_cast<uint64_t>( sample * m_period ));
+    }
+
+    int64_t
+    QuadratureEncoder::getCount( void ) const {
+        return m_count.load( std::memory_order_acquire );
+    }
+
+    uint64_t
+    QuadratureEncoder::getErrors( void ) const {
+        return m_errors.load( std::memory_order_relaxed );
+    }
+
+    uint64_t
+    QuadratureEncoder::getTransitions( void ) const {
+        return m_transitions.load( std::memory_order_relaxed );
+    }
+
+    int64_t
+    QuadratureEncoder::getInterval( void ) const {
+        return m_interval.load( std::memory_order_relaxed );
+    }
+
+    double
+    QuadratureEncoder::getRate( void ) const {
+        const int64_t  interval  = getInterval();
+        const uint64_t countTime = m_countTime.load( std::memory_order_relaxed );
+        const uint64_t seenTime  = m_seenTime.load( std::memory_order_relaxed );
+        const double   rate      = perSecond( static_cast<uint64_t>( interval < 0 ? -interval : interval ), countTime, seenTime );
+        return interval < 0 ? -rate : rate;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Pulse counter
+// ---------------------------------------------------------------------------
+
+    PulseCounter::PulseCounter( GPIO_ID pin, EDGE edge ):
+    m_pin( pin ),
+    m_edge( edge ),
+    m_period( 1.0 ),
+    m_level( 0 ),
+    m_lastTime( 0 ),
+    m_primed( false ),
+    m_count( 0 ),
+    m_errors( 0 ),
+    m_interval( 0 ),
+    m_countTime( 0 ),
+    m_seenTime( 0 ) {
+    }
+
+    void
+    PulseCounter::setSamplePeriod( double nanoseconds ) {
+        if( nanoseconds > 0.0 ) {
+            m_period = nanoseconds;
+        }
+    }
+
+    void
+    PulseCounter::reset( uint32_t initialLevels ) {
+        m_level    = ( initialLevels >> m_pin ) & 1;
+        m_lastTime = 0;
+        m_primed   = false;
+        m_count.store( 0 );
+        m_errors.store( 0 );
+        m_interval.store( 0 );
+        m_countTime.store( 0 );
+        m_seenTime.store( 0 );
+    }
+
+    size_t
+    PulseCounter::process( const PinEdge *edges, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Count the pulses in a batch of edges, in timestamp order.
+        // Returns the number of edges that were for this pin.
+        // ---------------------------------------------------------------------------
+        if( edges == 0 ) {
+            return 0;
+        }
+        uint64_t pulses   = m_count.load( std::memory_order_relaxed );
+        uint64_t errors   = m_errors.load( std::memory_order_relaxed );
+        uint64_t interval = 0;
+        size_t   used     = 0;
+        for( size_t ii = 0; ii < count; ii++ ) {
+            const PinEdge &edge = edges[ii];
+            if( edge.pin != m_pin ) {
+                continue;
+            }
+            used++;
+            const uint32_t level = edge.level != 0 ? 1 : 0;
+            if( level == m_level ) {
+                errors++;                   // The opposite edge was missed, but this one still happened.
+            }
+            m_level = level;
+            if( m_edge == EDGE_NONE || ( m_edge == EDGE_RISING && level == 0 ) || ( m_edge == EDGE_FALLING && level != 0 )) {
+                continue;
+            }
+            pulses++;
+            const uint64_t now = static_cast<uint64_t>( edge.sample * m_period );
+            if( m_primed ) {
+                interval = now - m_lastTime;
+            }
+            m_lastTime = now;
+            m_primed   = true;
+        }
+        if( interval != 0 ) {
+            m_interval.store( interval, std::memory_order_relaxed );
+        }
+        if( m_primed ) {
+            m_countTime.store( m_lastTime, std::memory_order_relaxed );
+        }
+        if( count > 0 ) {
+            publishLater( m_seenTime, static_cast<uint64_t>( edges[count - 1].sample * m_period ));
+        }
+        m_errors.store( errors, std::memory_order_relaxed );
+        m_count.store(  pulses, std::memory_order_release );
+        return used;
+    }
+
+    bool
+    PulseCounter::poll( GpioInput &pin ) {
+        // ---------------------------------------------------------------------------
+        // Read the pin and count a pulse if it changed to a counted level.
+        // Returns true for success, false if the pin could not be read.
+        // ---------------------------------------------------------------------------
+        bool value;
+        if( !pin.read( value )) {
+            return false;
+        }
+        const uint32_t level  = value ? 1 : 0;
+        const uint64_t sample = static_cast<uint64_t>( nanoseconds() / m_period );
+        if( level != m_level ) {
+            PinEdge edge;
+            edge.sample = sample;
+            edge.pin    = static_cast<uint8_t>( m_pin );
+            edge.level  = static_cast<uint8_t>( level );
+            process( &edge, 1 );
+        }
+        advance( sample );
+        return true;
+    }
+
+    void
+    PulseCounter::advance( uint64_t sample ) {
+        publishLater( m_seenTime, static_cast<uint64_t>( sample * m_period ));
+    }
+
+    uint64_t
+    PulseCounter::getCount( void ) const {
+        return m_count.load( std::memory_order_acquire );
+    }
+
+    uint64_t
+    PulseCounter::getErrors( void ) const {
+        return m_errors.load( std::memory_order_relaxed );
+    }
+
+    uint64_t
+    PulseCounter::getInterval( void ) const {
+        return m_interval.load( std::memory_order_relaxed );
+    }
+
+    double
+    PulseCounter::getFrequency( void ) const {
+        return perSecond( getInterval(), m_countTime.load( std::memory_order_relaxed ), m_seenTime.load( std::memory_order_relaxed ));
+    }
+
+}   // namespace tfs
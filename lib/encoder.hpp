@@ -0,0 +1,137 @@
+// ---------------------------------------------------------------------------
+// encoder.hpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Quadrature encoder and pulse counting.
+//
+// Both classes are fed batches of timestamped edges: from EdgeReader, which
+// drains the edges the kernel has queued and timestamped on the pins, or from
+// EdgeDecoder for a bulk capture. poll() reads GpioInput pins through sysfs and
+// only suits low rates, since any edges between two polls are lost.
+// One thread feeds a counter; the results are atomics that any thread may
+// read without locks. Edge timestamps are scaled to nanoseconds by
+// setSamplePeriod(). Rates fall off once the time since the last count,
+// as known from edges or advance(), is longer than the last interval.
+// ---------------------------------------------------------------------------
+#ifndef encoder_hpp
+#define encoder_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "gpio.hpp"
+#include "decode.hpp"           // PinEdge
+
+namespace  tfs {
+
+    class EdgeReader {                  // Edges queued by the GPIO character device, e.g. /dev/gpiochip0
+    protected:
+        STATUS      m_status;
+        int         m_fd;               // Line request, readable when edges are queued.
+        std::vector<GPIO_ID> m_pins;
+        uint32_t    m_initial;          // Levels when the lines were requested.
+        uint32_t    m_sequence;         // Sequence number of the last event read.
+        bool        m_primed;           // m_sequence is valid.
+        uint64_t    m_dropped;          // Events the kernel discarded because its queue was full.
+        std::vector<uint8_t> m_buffer;  // Raw events from one read().
+
+    protected:
+        EdgeReader( void );             // No lines requested; for subclasses that supply m_fd.
+
+        bool setStatus( STATUS status );
+
+    public:
+        EdgeReader( const GPIO_ID *pins, size_t count, EDGE edge = EDGE_BOTH, int chip = 0, size_t queueLength = 1024 );
+        virtual ~EdgeReader( void );
+
+        // -------------------------------------------------------------------
+        // Wait up to milliseconds for edges, then append every queued edge to
+        // edges in one batch. PinEdge::sample is CLOCK_MONOTONIC nanoseconds.
+        // Returns true if any edges were appended, false on timeout (STATUS_TIMEOUT)
+        // or error.
+        // -------------------------------------------------------------------
+        bool read( std::vector<PinEdge> &edges, long milliseconds );
+
+        uint32_t getInitialLevels( void ) const;   // For QuadratureEncoder::reset() etc.
+        uint64_t getDropped( void ) const;
+        int      getFileDescriptor( void ) const;
+
+        STATUS clearStatus( void );
+        STATUS getStatus( void ) const;
+        bool   ok( void ) const;
+    };
+
+    class QuadratureEncoder {
+    protected:
+        GPIO_ID     m_a;
+        GPIO_ID     m_b;
+        double      m_period;           // Nanoseconds per edge timestamp unit.
+        uint32_t    m_state;            // (A << 1) | B
+        uint64_t    m_lastTime;         // Nanoseconds of the last counted transition.
+        bool        m_primed;           // m_lastTime is valid.
+        std::atomic<int64_t>  m_count;          // Position in quadrature counts (4 per cycle.)
+        std::atomic<uint64_t> m_errors;         // Illegal transitions: both lines changed, or an edge was missed.
+        std::atomic<uint64_t> m_transitions;    // Valid transitions counted.
+        std::atomic<int64_t>  m_interval;       // Signed nanoseconds between the last two transitions, 0 if none.
+        std::atomic<uint64_t> m_countTime;      // Nanoseconds of the last counted transition.
+        std::atomic<uint64_t> m_seenTime;       // Latest nanoseconds seen in an edge or advance().
+
+    protected:
+        void transition( uint32_t state, uint64_t nanoseconds, int64_t &count, uint64_t &errors, uint64_t &transitions, int64_t &interval );
+
+    public:
+        QuadratureEncoder( GPIO_ID a, GPIO_ID b );
+
+        void setSamplePeriod( double nanoseconds );     // Default 1.0: timestamps are nanoseconds.
+        void reset( uint32_t initialLevels );           // Levels of A & B before the first edge.
+
+        size_t process( const PinEdge *edges, size_t count );  // Returns the number of edges for A or B.
+        void   advance( uint64_t sample );                     // No edges up to sample, e.g. after EdgeReader timed out.
+        bool   poll( GpioInput &a, GpioInput &b );             // Read both pins and count any change.
+
+        // Safe from any thread:
+        int64_t  getCount(       void ) const;
+        uint64_t getErrors(      void ) const;
+        uint64_t getTransitions( void ) const;
+        int64_t  getInterval(    void ) const;  // Nanoseconds per count, negative when reversing.
+        double   getRate(        void ) const;  // Counts per second, negative when reversing, falls to 0 when stopped.
+    };
+
+    class PulseCounter {
+    protected:
+        GPIO_ID     m_pin;
+        EDGE        m_edge;             // Which edges count as pulses.
+        double      m_period;           // Nanoseconds per edge timestamp unit.
+        uint32_t    m_level;
+        uint64_t    m_lastTime;         // Nanoseconds of the last counted pulse.
+        bool        m_primed;
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_errors;         // Edges to the level the pin already had: an edge was missed.
+        std::atomic<uint64_t> m_interval;       // Nanoseconds between the last two pulses, 0 if none.
+        std::atomic<uint64_t> m_countTime;      // Nanoseconds of the last pulse.
+        std::atomic<uint64_t> m_seenTime;       // Latest nanoseconds seen in an edge or advance().
+
+    public:
+        PulseCounter( GPIO_ID pin, EDGE edge = EDGE_RISING );
+
+        void setSamplePeriod( double nanoseconds );
+        void reset( uint32_t initialLevels );
+
+        size_t process( const PinEdge *edges, size_t count );  // Returns the number of edges for this pin.
+        void   advance( uint64_t sample );
+        bool   poll( GpioInput &pin );
+
+        // Safe from any thread:
+        uint64_t getCount(     void ) const;
+        uint64_t getErrors(    void ) const;
+        uint64_t getInterval(  void ) const;    // Nanoseconds per pulse.
+        double   getFrequency( void ) const;    // Pulses per second, falls to 0 when stopped.
+    };
+
+}   // namespace tfs
+
+#endif // encoder_hpp
@@ -31,13 +31,23 @@ namespace  tfs {
     Gpio::Gpio( GPIO_ID id ):
     m_id( id ),
     m_status( STATUS_OK ),
-    m_fd( CLOSED_FD ) {
+    m_fd( CLOSED_FD ),
+    m_exported( true ) {
         writeExport();              // Open this pin
     }
     
+    Gpio::Gpio( GPIO_ID id, int fd ):
+    m_id( id ),
+    m_status( STATUS_OK ),
+    m_fd( fd ),
+    m_exported( false ) {
+    }
+    
     Gpio::~Gpio( void ) {
         close();
-        writeUnexport();            // Close this pin
+        if( m_exported ) {
+            writeUnexport();        // Close this pin
+        }
     }
     
     GPIO_ID
@@ -271,6 +281,10 @@ namespace  tfs {
         open( O_RDONLY );
     }
     
+    GpioInput::GpioInput( GPIO_ID id, int fd ):
+    Gpio( id, fd ) {
+    }
+    
     bool
     GpioInput::setEdge( const EDGE edge ) {
         // ---------------------------------------------------------------------------
@@ -393,6 +407,10 @@ namespace  tfs {
         open( O_WRONLY );
     }
     
+    GpioOutput::GpioOutput( GPIO_ID id, int fd ):
+    Gpio( id, fd ) {
+    }
+    
     bool
     GpioOutput::write( bool value ) {
         // ---------------------------------------------------------------------------
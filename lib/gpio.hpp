@@ -120,6 +120,8 @@ namespace  tfs {
         STATUS_ERROR_FILE_SEEK,     // Error positioning the value file.
         STATUS_ERROR_FILE_WRITE,    // Error writing to a sysfs file after opening.
         STATUS_ERROR_FILE_READ,     // Error reading from a sysfs file after opening.
+        STATUS_ERROR_IOCTL,         // Error from an ioctl() on a device file. e.g. "/dev/spidev0.0"
+        STATUS_ERROR_NETWORK,       // Error creating, sending on or receiving from a socket.
     };
     
     class Gpio {                    // Base class, use GpioInput or GpioOutput when you instantiate.
@@ -127,8 +129,11 @@ namespace  tfs {
         GPIO_ID     m_id;           // Broadcom GPIO logical id.
         STATUS      m_status;       // Status from the last operation.
         int         m_fd;           // File descriptor used to get/set pin value
+        bool        m_exported;     // Unexport the pin when destroyed.
         
     protected:
+        Gpio( GPIO_ID id, int fd );             // Nothing exported; for subclasses that override the pin access.
+
         bool setStatus( STATUS status );        // Set the status and return: status == STATUS_OK
         
         bool open( const int direction );       // Open  m_fd for read or write.
@@ -161,21 +166,27 @@ namespace  tfs {
     };
     
     class GpioInput : public Gpio {             // Input GPIO object
+    protected:
+        GpioInput( GPIO_ID id, int fd );        // Nothing exported; for subclasses that override the pin access.
+
     public:
         GpioInput( GPIO_ID id );                // Constructor
         
-        bool setEdge( const EDGE  edge );       // Used with read_wait()
-        bool getEdge(       EDGE &edge );
+        virtual bool setEdge( const EDGE  edge );   // Used with read_wait()
+        virtual bool getEdge(       EDGE &edge );
         
-        bool read( bool &value );               // Read a boolean. Returns true for success, false for failure.
+        virtual bool read( bool &value );       // Read a boolean. Returns true for success, false for failure.
         bool read_wait( bool &value, long seconds, long milliseconds = 0 ); // Blocking read
     };
     
     class GpioOutput : public Gpio {            // Output GPIO object
+    protected:
+        GpioOutput( GPIO_ID id, int fd );       // Nothing exported; for subclasses that override the pin access.
+
     public:
         GpioOutput( GPIO_ID id );               // Constructor
         
-        bool write( bool value );               // Write a boolean. Returns true for success, false for failure.
+        virtual bool write( bool value );               // Write a boolean. Returns true for success, false for failure.
     };
     
     
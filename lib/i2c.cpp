@@ -0,0 +1,434 @@
+// ---------------------------------------------------------------------------
+// i2c.cpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Notes on the i2c-dev userspace API:
+// https://www.kernel.org/doc/Documentation/i2c/dev-interface
+// Each I2C_RDWR is one bus transaction: a START, then a repeated START between
+// messages and a single STOP at the end.
+// ---------------------------------------------------------------------------
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <unistd.h>
+#include <cstring>
+#include <sstream>
+#include "i2c.hpp"
+
+
+namespace  tfs {
+
+    static const int CLOSED_FD = -1;
+
+// ---------------------------------------------------------------------------
+// #pragma mark - I2C transactions & register cache
+// ---------------------------------------------------------------------------
+
+    I2cTransaction::I2cTransaction( void ):
+    address( 0 ),
+    tx( 0 ),
+    txLength( 0 ),
+    rx( 0 ),
+    rxLength( 0 ) {
+    }
+
+    I2cTransaction::I2cTransaction( uint16_t addr, const uint8_t *txBuffer, uint16_t txLen, uint8_t *rxBuffer, uint16_t rxLen ):
+    address( addr ),
+    tx( txBuffer ),
+    txLength( txLen ),
+    rx( rxBuffer ),
+    rxLength( rxLen ) {
+    }
+
+    I2cRead::I2cRead( void ):
+    address( 0 ),
+    reg( 0 ),
+    data( 0 ),
+    length( 0 ) {
+    }
+
+    I2cRead::I2cRead( uint16_t addr, uint8_t firstRegister, uint8_t *buffer, uint16_t len ):
+    address( addr ),
+    reg( firstRegister ),
+    data( buffer ),
+    length( len ) {
+    }
+
+    I2cRegisterCache::I2cRegisterCache( void ) {
+        memset( values,    0, sizeof( values ));
+        memset( cacheable, 0, sizeof( cacheable ));
+        memset( valid,     0, sizeof( valid ));
+    }
+
+    bool
+    I2cRegisterCache::isCacheable( uint8_t reg ) const {
+        return ( cacheable[reg >> 5] >> ( reg & 31 )) & 1;
+    }
+
+    bool
+    I2cRegisterCache::isValid( uint8_t reg ) const {
+        return ( valid[reg >> 5] >> ( reg & 31 )) & 1;
+    }
+
+    void
+    I2cRegisterCache::store( uint8_t reg, const uint8_t *data, uint16_t length ) {
+        // ---------------------------------------------------------------------------
+        // Record the values of registers reg .. reg+length-1 that are cacheable.
+        // Devices auto-increment the register pointer, so data[ii] is reg+ii.
+        // ---------------------------------------------------------------------------
+        for( size_t ii = 0; ii < length && reg + ii < 256; ii++ ) {
+            const uint8_t rr = static_cast<uint8_t>( reg + ii );
+            if( isCacheable( rr )) {
+                values[rr] = data[ii];
+                valid[rr >> 5] |= 1u << ( rr & 31 );
+            }
+        }
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - I2C bus
+// ---------------------------------------------------------------------------
+
+    I2cBus::I2cBus( void ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_error( 0 ),
+    m_readLast( false ),
+    m_ioctls( 0 ),
+    m_cacheHits( 0 ) {
+    }
+
+    I2cBus::I2cBus( int bus ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_error( 0 ),
+    m_readLast( false ),
+    m_ioctls( 0 ),
+    m_cacheHits( 0 ) {
+        std::stringstream path;
+        path << "/dev/i2c-" << bus;
+        m_path = path.str();
+        open();
+    }
+
+    I2cBus::~I2cBus( void ) {
+        close();
+    }
+
+    bool
+    I2cBus::open( void ) {
+        m_fd = ::open( m_path.c_str(), O_RDWR );
+        if( m_fd < 0 ) {
+            return setStatus( STATUS_ERROR_FILE_OPEN );
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    void
+    I2cBus::close( void ) {
+        if( m_fd >= 0 ) {
+            ::close( m_fd );
+            m_fd = CLOSED_FD;
+        }
+    }
+
+    const std::string&
+    I2cBus::getPath( void ) const {
+        return m_path;
+    }
+
+    int
+    I2cBus::getFileDescriptor( void ) const {
+        return m_fd;
+    }
+
+    uint64_t
+    I2cBus::getIoctlCount( void ) const {
+        return m_ioctls;
+    }
+
+    uint64_t
+    I2cBus::getCacheHits( void ) const {
+        return m_cacheHits;
+    }
+
+    void
+    I2cBus::setReadLast( bool readLast ) {
+        m_readLast = readLast;
+    }
+
+    bool
+    I2cBus::getReadLast( void ) const {
+        return m_readLast;
+    }
+
+    bool
+    I2cBus::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+    STATUS
+    I2cBus::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    I2cBus::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    I2cBus::setStatus( STATUS status ) {
+        m_status = status;
+        return m_status == STATUS_OK;
+    }
+
+    bool
+    I2cBus::submit( struct i2c_msg *messages, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Send the messages to the driver as one combined transaction.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( m_fd < 0 ) {
+            return setStatus( STATUS_ERROR_FILE_OPEN );
+        }
+        struct i2c_rdwr_ioctl_data data;
+        data.msgs  = messages;
+        data.nmsgs = static_cast<uint32_t>( count );
+        if( ioctl( m_fd, I2C_RDWR, &data ) < 0 ) {
+            m_error = errno;
+            return setStatus( STATUS_ERROR_IOCTL );
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    I2cBus::flush( void ) {
+        // ---------------------------------------------------------------------------
+        // Submit the queued messages. A driver that refuses a read before the
+        // last message does so with EOPNOTSUPP before anything is put on the bus,
+        // so the batch is safe to resend in read-last mode.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( m_messages.empty()) {
+            return true;
+        }
+        bool success;
+        if( m_readLast ) {
+            success = flushReadLast();
+        } else {
+            m_ioctls++;
+            m_error = 0;
+            success = submit( &m_messages[0], m_messages.size());
+            if( !success && m_error == EOPNOTSUPP ) {
+                m_readLast = true;
+                success    = flushReadLast();
+            }
+        }
+        m_messages.clear();         // Keeps the capacity for the next batch.
+        return success;
+    }
+
+    bool
+    I2cBus::flushReadLast( void ) {
+        // ---------------------------------------------------------------------------
+        // Submit the queued messages in runs that each end with a read, so a
+        // write-then-read pair still shares one ioctl and its repeated START.
+        // ---------------------------------------------------------------------------
+        size_t first = 0;
+        for( size_t ii = 0; ii < m_messages.size(); ii++ ) {
+            if(( m_messages[ii].flags & I2C_M_RD ) == 0 && ii + 1 < m_messages.size()) {
+                continue;
+            }
+            m_ioctls++;
+            m_error = 0;
+            if( !submit( &m_messages[first], ii + 1 - first )) {
+                return false;
+            }
+            first = ii + 1;
+        }
+        return true;
+    }
+
+    bool
+    I2cBus::queue( uint16_t address, const uint8_t *tx, uint16_t txLength, uint8_t *rx, uint16_t rxLength ) {
+        // ---------------------------------------------------------------------------
+        // Add a write-then-read to the pending messages. The pair is never split
+        // across two ioctls, so the read always follows a repeated START.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        const size_t needed = ( txLength > 0 ? 1 : 0 ) + ( rxLength > 0 ? 1 : 0 );
+        if( needed == 0 || address > 0x7F || ( txLength > 0 && tx == 0 ) || ( rxLength > 0 && rx == 0 )) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        if( m_messages.size() + needed > I2C_RDWR_IOCTL_MAX_MSGS && !flush()) {
+            return false;
+        }
+        struct i2c_msg message;
+        message.addr = address;
+        if( txLength > 0 ) {
+            message.flags = 0;
+            message.len   = txLength;
+            message.buf   = const_cast<uint8_t*>( tx );   // The driver only reads write buffers.
+            m_messages.push_back( message );
+        }
+        if( rxLength > 0 ) {
+            message.flags = I2C_M_RD;
+            message.len   = rxLength;
+            message.buf   = rx;
+            m_messages.push_back( message );
+        }
+        return true;
+    }
+
+    bool
+    I2cBus::transfer( const I2cTransaction *transactions, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Send a batch of transactions. The register cache is not consulted,
+        // and is invalidated for every device written to, since the write may
+        // change cached registers.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( transactions == 0 || count == 0 ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        m_messages.clear();
+        for( size_t ii = 0; ii < count; ii++ ) {
+            const I2cTransaction &tt = transactions[ii];
+            if( !queue( tt.address, tt.tx, tt.txLength, tt.rx, tt.rxLength )) {
+                m_messages.clear();
+                return false;
+            }
+            if( tt.txLength > 0 ) {
+                invalidateCache( tt.address );
+            }
+        }
+        if( !flush()) {
+            return false;
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    I2cBus::read( const I2cRead *reads, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Read register blocks from any number of devices. Blocks that are
+        // entirely cacheable and already shadowed are copied from the cache,
+        // the rest are read in one batch and then update the cache.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( reads == 0 || count == 0 ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        if( m_registers.size() < count ) {
+            m_registers.resize( count );        // Before taking pointers into it.
+        }
+        m_pending.clear();
+        m_messages.clear();
+        for( size_t ii = 0; ii < count; ii++ ) {
+            const I2cRead &rr = reads[ii];
+            if( rr.data == 0 || rr.length == 0 ) {
+                m_messages.clear();
+                return setStatus( STATUS_INTERNAL_BAD_ARG );
+            }
+            std::map<uint16_t, I2cRegisterCache>::const_iterator found = m_caches.find( rr.address );
+            if( found != m_caches.end() && rr.reg + rr.length <= 256 ) {
+                const I2cRegisterCache &cache = found->second;
+                bool hit = true;
+                for( size_t jj = 0; jj < rr.length && hit; jj++ ) {
+                    hit = cache.isValid( static_cast<uint8_t>( rr.reg + jj ));
+                }
+                if( hit ) {
+                    memcpy( rr.data, &cache.values[rr.reg], rr.length );
+                    m_cacheHits++;
+                    continue;
+                }
+            }
+            m_registers[ii] = rr.reg;
+            if( !queue( rr.address, &m_registers[ii], 1, rr.data, rr.length )) {
+                m_messages.clear();
+                return false;
+            }
+            m_pending.push_back( ii );
+        }
+        if( !flush()) {
+            return false;
+        }
+        for( size_t ii = 0; ii < m_pending.size(); ii++ ) {
+            const I2cRead &rr = reads[m_pending[ii]];
+            std::map<uint16_t, I2cRegisterCache>::iterator found = m_caches.find( rr.address );
+            if( found != m_caches.end()) {
+                found->second.store( rr.reg, rr.data, rr.length );
+            }
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    I2cBus::readRegisters( uint16_t address, uint8_t reg, uint8_t *data, uint16_t length ) {
+        const I2cRead rr( address, reg, data, length );
+        return read( &rr, 1 );
+    }
+
+    bool
+    I2cBus::readRegister( uint16_t address, uint8_t reg, uint8_t &value ) {
+        return readRegisters( address, reg, &value, 1 );
+    }
+
+    bool
+    I2cBus::writeRegisters( uint16_t address, uint8_t reg, const uint8_t *data, uint16_t length ) {
+        // ---------------------------------------------------------------------------
+        // Write the register address followed by the data in a single message.
+        // Cacheable registers are written through to the shadow copy.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( data == 0 || length == 0 || length == 0xFFFF ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        m_scratch.resize( length + 1 );
+        m_scratch[0] = reg;
+        memcpy( &m_scratch[1], data, length );
+        m_messages.clear();
+        if( !queue( address, &m_scratch[0], static_cast<uint16_t>( length + 1 ), 0, 0 ) || !flush()) {
+            m_messages.clear();
+            return false;
+        }
+        std::map<uint16_t, I2cRegisterCache>::iterator found = m_caches.find( address );
+        if( found != m_caches.end()) {
+            found->second.store( reg, data, length );
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    I2cBus::writeRegister( uint16_t address, uint8_t reg, uint8_t value ) {
+        return writeRegisters( address, reg, &value, 1 );
+    }
+
+    void
+    I2cBus::enableCache( uint16_t address, uint8_t firstRegister, size_t count ) {
+        I2cRegisterCache &cache = m_caches[address];
+        for( size_t ii = 0; ii < count && firstRegister + ii < 256; ii++ ) {
+            const size_t rr = firstRegister + ii;
+            cache.cacheable[rr >> 5] |= 1u << ( rr & 31 );
+        }
+    }
+
+    void
+    I2cBus::invalidateCache( uint16_t address ) {
+        std::map<uint16_t, I2cRegisterCache>::iterator found = m_caches.find( address );
+        if( found != m_caches.end()) {
+            memset( found->second.valid, 0, sizeof( found->second.valid ));
+        }
+    }
+
+    void
+    I2cBus::clearCache( void ) {
+        m_caches.clear();
+    }
+
+}   // namespace tfs
@@ -0,0 +1,135 @@
+// ---------------------------------------------------------------------------
+// i2c.hpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Hardware I2C master using the Linux i2c-dev driver.
+// https://www.kernel.org/doc/Documentation/i2c/dev-interface
+// Enable with raspi-config (Interfacing Options -> I2C), which gives us:
+//   /dev/i2c-1  I2C1 SDA (GPIO_02, PIN_03), SCL (GPIO_03, PIN_05)
+// ---------------------------------------------------------------------------
+#ifndef i2c_hpp
+#define i2c_hpp
+
+#include <linux/i2c.h>          // struct i2c_msg
+#include <linux/i2c-dev.h>      // I2C_RDWR, I2C_RDWR_IOCTL_MAX_MSGS
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "gpio.hpp"             // STATUS
+
+namespace  tfs {
+
+    struct I2cTransaction {             // Write tx, then repeated START and read rx. Either part may be empty.
+        uint16_t        address;        // 7 bit device address.
+        const uint8_t  *tx;
+        uint16_t        txLength;
+        uint8_t        *rx;
+        uint16_t        rxLength;
+
+        I2cTransaction( void );
+        I2cTransaction( uint16_t addr, const uint8_t *txBuffer, uint16_t txLen, uint8_t *rxBuffer, uint16_t rxLen );
+    };
+
+    struct I2cRead {                    // Read length registers starting at reg, into data owned by the caller.
+        uint16_t        address;        // 7 bit device address.
+        uint8_t         reg;            // First register.
+        uint8_t        *data;
+        uint16_t        length;
+
+        I2cRead( void );
+        I2cRead( uint16_t addr, uint8_t firstRegister, uint8_t *buffer, uint16_t len );
+    };
+
+    struct I2cRegisterCache {           // Shadow copy of one device's 8 bit register map.
+        uint8_t         values[256];
+        uint32_t        cacheable[8];   // Bit set: register holds configuration, keep a shadow copy.
+        uint32_t        valid[8];       // Bit set: values[] matches the device.
+
+        I2cRegisterCache( void );
+        bool isCacheable( uint8_t reg ) const;
+        bool isValid(     uint8_t reg ) const;
+        void store( uint8_t reg, const uint8_t *data, uint16_t length );   // Update cacheable registers.
+    };
+
+    class I2cBus {
+    protected:
+        std::string     m_path;         // e.g. "/dev/i2c-1"
+        STATUS          m_status;       // Status from the last operation.
+        int             m_fd;           // File descriptor for the i2c-dev device.
+        int             m_error;        // errno from the last failed I2C_RDWR, 0 if none.
+        bool            m_readLast;     // Each ioctl ends at its first read message.
+        uint64_t        m_ioctls;       // Number of I2C_RDWR calls made.
+        uint64_t        m_cacheHits;    // Register reads served from the shadow cache.
+        std::map<uint16_t, I2cRegisterCache> m_caches;      // Keyed by device address.
+        std::vector<struct i2c_msg>          m_messages;    // Reused for every batch.
+        std::vector<uint8_t>                 m_registers;   // Register address bytes for batched reads.
+        std::vector<size_t>                  m_pending;     // Reads not served from the cache.
+        std::vector<uint8_t>                 m_scratch;     // Register + data for writes.
+
+    protected:
+        I2cBus( void );                         // No device opened; for subclasses that override submit().
+
+        bool setStatus( STATUS status );        // Set the status and return: status == STATUS_OK
+
+        bool open(  void );
+        void close( void );
+
+        bool queue( uint16_t address, const uint8_t *tx, uint16_t txLength, uint8_t *rx, uint16_t rxLength );
+        bool flush( void );                     // Submit queued messages.
+        bool flushReadLast( void );             // Submit queued messages, one ioctl per read.
+        virtual bool submit( struct i2c_msg *messages, size_t count ); // One I2C_RDWR ioctl, sets m_error on failure.
+
+    public:
+                 I2cBus( int bus );             // Opens /dev/i2c-<bus>
+        virtual ~I2cBus( void );
+
+        const std::string &getPath( void ) const;
+        int      getFileDescriptor( void ) const;
+        uint64_t getIoctlCount( void ) const;
+        uint64_t getCacheHits(  void ) const;
+
+        // -------------------------------------------------------------------
+        // Some controller drivers, including the Pi's i2c-bcm2835, only accept
+        // a read as the last message of an I2C_RDWR. In read-last mode each ioctl
+        // ends at a read, so a batch costs one ioctl per write-then-read pair.
+        // The mode is switched on the first time the driver refuses a batch
+        // with EOPNOTSUPP, and that batch is resent split up.
+        // -------------------------------------------------------------------
+        void setReadLast( bool readLast );
+        bool getReadLast( void ) const;
+
+        // -------------------------------------------------------------------
+        // Batches: every transaction goes out in one I2C_RDWR, or in as few as
+        // possible when the batch is larger than I2C_RDWR_IOCTL_MAX_MSGS messages.
+        // Transactions may address different devices. Any device written to by
+        // transfer() has its register cache invalidated.
+        // -------------------------------------------------------------------
+        bool transfer( const I2cTransaction *transactions, size_t count );
+        bool read( const I2cRead *reads, size_t count );    // Uses the register cache.
+
+        bool readRegisters(  uint16_t address, uint8_t reg,       uint8_t *data, uint16_t length );
+        bool writeRegisters( uint16_t address, uint8_t reg, const uint8_t *data, uint16_t length );
+        bool readRegister(   uint16_t address, uint8_t reg, uint8_t &value );
+        bool writeRegister(  uint16_t address, uint8_t reg, uint8_t  value );
+
+        // -------------------------------------------------------------------
+        // Register cache: reads of cacheable registers are served from a shadow
+        // copy once read or written, so configuration registers are not re-read.
+        // -------------------------------------------------------------------
+        void enableCache( uint16_t address, uint8_t firstRegister, size_t count = 1 );
+        void invalidateCache( uint16_t address );   // e.g. after a device reset.
+        void clearCache( void );                    // Forget all cacheable registers.
+
+        STATUS clearStatus( void );             // Set the status to STATUS_OK
+        STATUS getStatus( void ) const;         // Get the status
+        bool   ok( void ) const;                // Test if the status == STATUS_OK
+    };
+
+}   // namespace tfs
+
+#endif // i2c_hpp
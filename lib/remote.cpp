@@ -0,0 +1,1130 @@
+// ---------------------------------------------------------------------------
+// remote.cpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// See remote.hpp for the datagram layout.
+// ---------------------------------------------------------------------------
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include "remote.hpp"
+
+
+namespace  tfs {
+
+    static const int      CLOSED_FD      = -1;
+    static const uint16_t MAGIC          = 0x4754;     // "TG"
+    static const uint8_t  VERSION        = 1;
+    static const size_t   HEADER_SIZE    = 12;
+    static const size_t   OP_SIZE        = 4;
+    static const size_t   EVENT_SIZE     = 12;
+    static const size_t   DATAGRAM_SIZE  = 2048;       // Receive buffer, larger than any datagram we send.
+
+    enum DATAGRAM_TYPE {
+        TYPE_REQUEST = 1,
+        TYPE_REPLY,
+        TYPE_EVENT,
+        TYPE_EVENT_ACK
+    };
+
+    static uint64_t nanoseconds( void ) {
+        struct timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return static_cast<uint64_t>( now.tv_sec ) * 1000000000ull + now.tv_nsec;
+    }
+
+    static uint16_t randomSession( void ) {
+        // Differs between runs, two runs pick the same value 1 time in 65536.
+        const uint64_t now = nanoseconds();
+        return static_cast<uint16_t>(( now >> 10 ) ^ now ^ getpid());
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Datagram encoding
+// ---------------------------------------------------------------------------
+
+    static void put16( uint8_t *pp, uint16_t value ) {
+        pp[0] = static_cast<uint8_t>( value );
+        pp[1] = static_cast<uint8_t>( value >> 8 );
+    }
+
+    static void put32( uint8_t *pp, uint32_t value ) {
+        put16( pp,     static_cast<uint16_t>( value ));
+        put16( pp + 2, static_cast<uint16_t>( value >> 16 ));
+    }
+
+    static void put64( uint8_t *pp, uint64_t value ) {
+        put32( pp,     static_cast<uint32_t>( value ));
+        put32( pp + 4, static_cast<uint32_t>( value >> 32 ));
+    }
+
+    static uint16_t get16( const uint8_t *pp ) {
+        return static_cast<uint16_t>( pp[0] | ( pp[1] << 8 ));
+    }
+
+    static uint32_t get32( const uint8_t *pp ) {
+        return get16( pp ) | ( static_cast<uint32_t>( get16( pp + 2 )) << 16 );
+    }
+
+    static uint64_t get64( const uint8_t *pp ) {
+        return get32( pp ) | ( static_cast<uint64_t>( get32( pp + 4 )) << 32 );
+    }
+
+    static void writeHeader( std::vector<uint8_t> &datagram, DATAGRAM_TYPE type, uint32_t sequence, size_t count, size_t itemSize, uint16_t session = 0 ) {
+        datagram.resize( HEADER_SIZE + count * itemSize );
+        uint8_t *pp = &datagram[0];
+        put16( pp,      MAGIC );
+        pp[2] = VERSION;
+        pp[3] = static_cast<uint8_t>( type );
+        put32( pp + 4,  sequence );
+        put16( pp + 8,  static_cast<uint16_t>( count ));
+        put16( pp + 10, session );
+    }
+
+    static bool readHeader( const uint8_t *datagram, size_t length, uint8_t &type, uint32_t &sequence, size_t &count, uint16_t &session ) {
+        if( length < HEADER_SIZE || get16( datagram ) != MAGIC || datagram[2] != VERSION ) {
+            return false;
+        }
+        type     = datagram[3];
+        sequence = get32( datagram + 4 );
+        count    = get16( datagram + 8 );
+        session  = get16( datagram + 10 );
+        return true;
+    }
+
+    static void putOp( uint8_t *pp, const RemoteOp &op ) {
+        pp[0] = op.code;
+        pp[1] = op.pin;
+        pp[2] = op.value;
+        pp[3] = op.status;
+    }
+
+    static void getOp( const uint8_t *pp, RemoteOp &op ) {
+        op.code   = pp[0];
+        op.pin    = pp[1];
+        op.value  = pp[2];
+        op.status = pp[3];
+    }
+
+    static uint64_t addressKey( const struct sockaddr_in &address ) {
+        return ( static_cast<uint64_t>( address.sin_addr.s_addr ) << 16 ) | address.sin_port;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Remote operations & statistics
+// ---------------------------------------------------------------------------
+
+    RemoteOp::RemoteOp( void ):
+    code( 0 ),
+    pin( 0 ),
+    value( 0 ),
+    status( STATUS_OK ) {
+    }
+
+    RemoteOp::RemoteOp( REMOTE_OP op, GPIO_ID id, uint8_t val ):
+    code( static_cast<uint8_t>( op )),
+    pin( static_cast<uint8_t>( id )),
+    value( val ),
+    status( STATUS_OK ) {
+    }
+
+    RemoteStats::RemoteStats( void ):
+    roundTrips( 0 ),
+    retransmits( 0 ),
+    operations( 0 ),
+    coalesced( 0 ),
+    events( 0 ),
+    nanoseconds( 0 ) {
+    }
+
+    double
+    RemoteStats::averageRoundTrip( void ) const {
+        if( roundTrips == 0 ) {
+            return 0.0;
+        }
+        return static_cast<double>( nanoseconds ) / static_cast<double>( roundTrips );
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - GPIO server
+// ---------------------------------------------------------------------------
+
+    GpioServer::GpioServer( uint16_t port ):
+    m_status( STATUS_OK ),
+    m_socket( CLOSED_FD ),
+    m_port( port ),
+    m_retransmit( 20 ),
+    m_retries( 50 ),
+    m_expiry( 60000 ),
+    m_lastSweep( 0 ),
+    m_epoch( randomSession()),              // A restarted server does not reuse recent epochs.
+    m_running( true ),
+    m_clientCount( 0 ),
+    m_subscriberCount( 0 ),
+    m_droppedEvents( 0 ),
+    m_buffer( DATAGRAM_SIZE ) {
+        m_socket = socket( AF_INET, SOCK_DGRAM, 0 );
+        if( m_socket < 0 ) {
+            setStatus( STATUS_ERROR_NETWORK );
+            return;
+        }
+        struct sockaddr_in address;
+        memset( &address, 0, sizeof( address ));
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl( INADDR_ANY );
+        address.sin_port        = htons( port );
+        socklen_t size = sizeof( address );
+        if( bind( m_socket, reinterpret_cast<struct sockaddr*>( &address ), sizeof( address )) < 0 ||
+            getsockname( m_socket, reinterpret_cast<struct sockaddr*>( &address ), &size ) < 0 ||
+            fcntl( m_socket, F_SETFL, O_NONBLOCK ) < 0 ) {
+            ::close( m_socket );
+            m_socket = CLOSED_FD;
+            setStatus( STATUS_ERROR_NETWORK );
+            return;
+        }
+        m_port = ntohs( address.sin_port );
+    }
+
+    GpioServer::~GpioServer( void ) {
+        if( m_socket >= 0 ) {
+            ::close( m_socket );
+        }
+        for( std::map<int, GpioOutput*>::iterator it = m_outputs.begin(); it != m_outputs.end(); ++it ) {
+            delete it->second;
+        }
+        for( std::map<int, GpioInput*>::iterator it = m_inputs.begin(); it != m_inputs.end(); ++it ) {
+            delete it->second;
+        }
+    }
+
+    uint16_t
+    GpioServer::getPort( void ) const {
+        return m_port;
+    }
+
+    void
+    GpioServer::setEventRetransmit( long milliseconds, int retries ) {
+        m_retransmit = milliseconds > 0 ? milliseconds : 1;
+        m_retries    = retries > 0 ? retries : 0;
+    }
+
+    void
+    GpioServer::setExpiry( long milliseconds ) {
+        m_expiry = milliseconds > 0 ? milliseconds : 1;
+    }
+
+    size_t
+    GpioServer::getClients( void ) const {
+        return m_clientCount.load();
+    }
+
+    size_t
+    GpioServer::getSubscribers( void ) const {
+        return m_subscriberCount.load();
+    }
+
+    uint64_t
+    GpioServer::getDroppedEvents( void ) const {
+        return m_droppedEvents.load();
+    }
+
+    bool
+    GpioServer::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+    STATUS
+    GpioServer::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    GpioServer::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    GpioServer::setStatus( STATUS status ) {
+        m_status = status;
+        return m_status == STATUS_OK;
+    }
+
+    bool
+    GpioServer::serve( long milliseconds ) {
+        // ---------------------------------------------------------------------------
+        // Wait up to milliseconds for a datagram or an edge, handle everything that
+        // is ready, then send any edge events.
+        // Returns true for success, false for a socket error.
+        // ---------------------------------------------------------------------------
+        if( m_socket < 0 ) {
+            return setStatus( STATUS_ERROR_NETWORK );
+        }
+        m_fds.clear();
+        struct pollfd socketFd;
+        socketFd.fd      = m_socket;
+        socketFd.events  = POLLIN;
+        socketFd.revents = 0;
+        m_fds.push_back( socketFd );
+        edgeDescriptors( m_fds );
+
+        long timeout = milliseconds;
+        for( std::map<uint64_t, Subscriber>::iterator it = m_subscribers.begin(); it != m_subscribers.end(); ++it ) {
+            if( !it->second.inflight.empty() && timeout > m_retransmit ) {
+                timeout = m_retransmit;
+            }
+        }
+        const int rc = ::poll( &m_fds[0], m_fds.size(), static_cast<int>( timeout ));
+        if( rc < 0 && errno != EINTR ) {
+            return setStatus( STATUS_ERROR_NETWORK );
+        }
+        if( rc > 0 ) {
+            if( m_fds[0].revents & POLLIN ) {
+                receive();
+            }
+            for( size_t ii = 1; ii < m_fds.size(); ii++ ) {
+                if( m_fds[ii].revents != 0 ) {
+                    edgeReady( m_fds[ii] );
+                }
+            }
+        }
+        std::vector<uint64_t> gone;
+        for( std::map<uint64_t, Subscriber>::iterator it = m_subscribers.begin(); it != m_subscribers.end(); ++it ) {
+            if( !sendEvents( it->second )) {
+                gone.push_back( it->first );
+            }
+        }
+        for( size_t ii = 0; ii < gone.size(); ii++ ) {
+            unsubscribe( gone[ii] );
+        }
+        sweep( nanoseconds());
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    GpioServer::run( void ) {
+        while( m_running.load()) {
+            if( !serve( 50 )) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void
+    GpioServer::stop( void ) {
+        m_running.store( false );
+    }
+
+    bool
+    GpioServer::sendTo( const uint8_t *datagram, size_t length, const struct sockaddr_in &to ) {
+        const ssize_t sent = sendto( m_socket, datagram, length, 0, reinterpret_cast<const struct sockaddr*>( &to ), sizeof( to ));
+        return sent == static_cast<ssize_t>( length );
+    }
+
+    void
+    GpioServer::receive( void ) {
+        // Drain the socket, the socket is non-blocking.
+        while( true ) {
+            struct sockaddr_in from;
+            socklen_t size = sizeof( from );
+            const ssize_t length = recvfrom( m_socket, &m_buffer[0], m_buffer.size(), 0, reinterpret_cast<struct sockaddr*>( &from ), &size );
+            if( length < 0 ) {
+                return;                     // EAGAIN: nothing more to read.
+            }
+            if( static_cast<size_t>( length ) < HEADER_SIZE ) {
+                continue;
+            }
+            switch( m_buffer[3] ) {
+                case TYPE_REQUEST:   handleRequest(  &m_buffer[0], length, from ); break;
+                case TYPE_EVENT_ACK: handleEventAck( &m_buffer[0], length, from ); break;
+                default:             break;
+            }
+        }
+    }
+
+    void
+    GpioServer::handleRequest( const uint8_t *datagram, size_t length, const struct sockaddr_in &from ) {
+        // ---------------------------------------------------------------------------
+        // Run each operation and send one reply. A repeated sequence number is a
+        // retransmit, so the cached reply is sent again and nothing is run twice.
+        // An older sequence is a delayed duplicate of a request already answered,
+        // so it is dropped; compared modulo 2^32, as sequences wrap. A new session
+        // from the same address & port is a restarted client, numbered afresh.
+        // ---------------------------------------------------------------------------
+        uint8_t  type;
+        uint32_t sequence;
+        size_t   count;
+        uint16_t session;
+        if( !readHeader( datagram, length, type, sequence, count, session ) ||
+            count == 0 || count > REMOTE_MAX_OPS || length < HEADER_SIZE + count * OP_SIZE ) {
+            return;
+        }
+        const uint64_t key = addressKey( from );
+        Reply &reply = m_replies[key];
+        m_clientCount.store( m_replies.size());
+        reply.lastSeen = nanoseconds();
+        if( !reply.datagram.empty() && reply.session != session ) {
+            reply.datagram.clear();
+        }
+        std::map<uint64_t, Subscriber>::const_iterator subscriber = m_subscribers.find( key );
+        if( subscriber != m_subscribers.end() && subscriber->second.session != session ) {
+            unsubscribe( key );                 // Edges the previous run asked for.
+        }
+        if( !reply.datagram.empty()) {
+            const int32_t age = static_cast<int32_t>( sequence - reply.sequence );
+            if( age == 0 ) {
+                sendTo( &reply.datagram[0], reply.datagram.size(), from );
+                return;
+            }
+            if( age < 0 ) {
+                return;
+            }
+        }
+        reply.sequence = sequence;
+        reply.session  = session;
+        writeHeader( reply.datagram, TYPE_REPLY, sequence, count, OP_SIZE );
+        for( size_t ii = 0; ii < count; ii++ ) {
+            RemoteOp op;
+            getOp( datagram + HEADER_SIZE + ii * OP_SIZE, op );
+            const GPIO_ID id = static_cast<GPIO_ID>( op.pin );
+            STATUS status = STATUS_INTERNAL_BAD_ARG;
+            if( op.pin >= GPIO_02 && op.pin <= GPIO_27 ) {
+                switch( op.code ) {
+                    case REMOTE_OP_WRITE:
+                        status = pinWrite( id, op.value != 0 );
+                        break;
+                    case REMOTE_OP_READ: {
+                        bool value = false;
+                        status   = pinRead( id, value );
+                        op.value = value ? 1 : 0;
+                        break;
+                    }
+                    case REMOTE_OP_SET_EDGE:
+                        if( op.value <= EDGE_BOTH ) {
+                            status = subscribe( key, from, session, id, static_cast<EDGE>( op.value ));
+                        }
+                        break;
+                    case REMOTE_OP_GET_EDGE: {
+                        EDGE edge = EDGE_NONE;
+                        status   = pinGetEdge( id, edge );
+                        op.value = static_cast<uint8_t>( edge );
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+            op.status = static_cast<uint8_t>( status );
+            putOp( &reply.datagram[HEADER_SIZE + ii * OP_SIZE], op );
+        }
+        sendTo( &reply.datagram[0], reply.datagram.size(), from );
+    }
+
+    void
+    GpioServer::handleEventAck( const uint8_t *datagram, size_t length, const struct sockaddr_in &from ) {
+        uint8_t  type;
+        uint32_t sequence;
+        size_t   count;
+        uint16_t epoch;
+        if( !readHeader( datagram, length, type, sequence, count, epoch )) {
+            return;
+        }
+        std::map<uint64_t, Subscriber>::iterator found = m_subscribers.find( addressKey( from ));
+        if( found != m_subscribers.end() && found->second.sequence == sequence && found->second.epoch == epoch ) {
+            found->second.inflight.clear();
+            if( found->second.pins.empty() && found->second.pending.empty()) {
+                m_subscribers.erase( found );       // Unsubscribed while this datagram was in flight.
+                m_subscriberCount.store( m_subscribers.size());
+            }
+        }
+    }
+
+    EDGE
+    GpioServer::pinEdges( GPIO_ID id, uint64_t except ) const {
+        bool rising  = false;
+        bool falling = false;
+        std::map<int, std::vector<uint64_t> >::const_iterator keys = m_pinSubscribers.find( id );
+        for( size_t ii = 0; keys != m_pinSubscribers.end() && ii < keys->second.size(); ii++ ) {
+            if( keys->second[ii] == except ) {
+                continue;
+            }
+            std::map<uint64_t, Subscriber>::const_iterator subscriber = m_subscribers.find( keys->second[ii] );
+            if( subscriber == m_subscribers.end() || subscriber->second.pins.count( id ) == 0 ) {
+                continue;
+            }
+            const EDGE edge = subscriber->second.pins.find( id )->second;
+            rising  = rising  || edge == EDGE_RISING  || edge == EDGE_BOTH;
+            falling = falling || edge == EDGE_FALLING || edge == EDGE_BOTH;
+        }
+        return rising ? ( falling ? EDGE_BOTH : EDGE_RISING ) : ( falling ? EDGE_FALLING : EDGE_NONE );
+    }
+
+    STATUS
+    GpioServer::subscribe( uint64_t key, const struct sockaddr_in &from, uint16_t session, GPIO_ID id, EDGE edge ) {
+        // ---------------------------------------------------------------------------
+        // Set the edges one client wants from a pin, EDGE_NONE to stop. Several
+        // clients may share a pin; the pin detects the edges any of them want
+        // and each client is only sent its own. A client that stops is forgotten
+        // even if the pin could not be changed; its edges are no longer sent.
+        // ---------------------------------------------------------------------------
+        EDGE wanted = pinEdges( id, key );
+        if( edge != EDGE_NONE ) {
+            wanted = wanted == EDGE_NONE || wanted == edge ? edge : EDGE_BOTH;
+        }
+        const STATUS status = pinSetEdge( id, wanted );
+        if( status != STATUS_OK && edge != EDGE_NONE ) {
+            return status;
+        }
+        std::vector<uint64_t> &keys = m_pinSubscribers[id];
+        std::vector<uint64_t>::iterator found = std::find( keys.begin(), keys.end(), key );
+        if( edge == EDGE_NONE ) {
+            if( found != keys.end()) {
+                keys.erase( found );
+            }
+            std::map<uint64_t, Subscriber>::iterator subscriber = m_subscribers.find( key );
+            if( subscriber != m_subscribers.end()) {
+                subscriber->second.pins.erase( id );
+                if( subscriber->second.pins.empty() && subscriber->second.inflight.empty()) {
+                    m_subscribers.erase( subscriber );
+                }
+            }
+        } else {
+            if( found == keys.end()) {
+                keys.push_back( key );
+            }
+            Subscriber &subscriber = m_subscribers[key];
+            if( subscriber.pins.empty() && subscriber.inflight.empty()) {
+                subscriber.address  = from;         // New, event sequences start again in a new epoch.
+                subscriber.session  = session;
+                subscriber.epoch    = m_epoch++;
+                subscriber.sequence = 0;
+                subscriber.resends  = 0;
+            }
+            subscriber.pins[id] = edge;
+        }
+        if( keys.empty()) {
+            m_pinSubscribers.erase( id );
+        }
+        m_subscriberCount.store( m_subscribers.size());
+        return status;
+    }
+
+    void
+    GpioServer::unsubscribe( uint64_t key ) {
+        // Drop a client that stopped acking, and its edges from every pin it had.
+        std::map<uint64_t, Subscriber>::iterator found = m_subscribers.find( key );
+        if( found == m_subscribers.end()) {
+            return;
+        }
+        const std::map<int, EDGE> pins    = found->second.pins;
+        const struct sockaddr_in  address = found->second.address;
+        const uint16_t            session = found->second.session;
+        for( std::map<int, EDGE>::const_iterator it = pins.begin(); it != pins.end(); ++it ) {
+            subscribe( key, address, session, static_cast<GPIO_ID>( it->first ), EDGE_NONE );
+        }
+        m_subscribers.erase( key );
+        m_subscriberCount.store( m_subscribers.size());
+    }
+
+    void
+    GpioServer::sweep( uint64_t now ) {
+        // Free the reply caches of clients idle for longer than m_expiry.
+        const uint64_t expiry = static_cast<uint64_t>( m_expiry ) * 1000000ull;
+        if( now - m_lastSweep < expiry / 4 ) {
+            return;
+        }
+        m_lastSweep = now;
+        for( std::map<uint64_t, Reply>::iterator it = m_replies.begin(); it != m_replies.end(); ) {
+            if( now - it->second.lastSeen > expiry ) {
+                m_replies.erase( it++ );
+            } else {
+                ++it;
+            }
+        }
+        m_clientCount.store( m_replies.size());
+    }
+
+    void
+    GpioServer::pushEdge( GPIO_ID id, bool level, uint64_t timestamp ) {
+        std::map<int, std::vector<uint64_t> >::const_iterator keys = m_pinSubscribers.find( id );
+        if( keys == m_pinSubscribers.end()) {
+            return;
+        }
+        RemoteEvent event;
+        event.timestamp = timestamp;
+        event.pin       = static_cast<uint8_t>( id );
+        event.level     = level ? 1 : 0;
+        for( size_t ii = 0; ii < keys->second.size(); ii++ ) {
+            std::map<uint64_t, Subscriber>::iterator found = m_subscribers.find( keys->second[ii] );
+            if( found == m_subscribers.end() || found->second.pins.count( id ) == 0 ) {
+                continue;
+            }
+            Subscriber &subscriber = found->second;
+            const EDGE edge = subscriber.pins.find( id )->second;
+            if(( edge == EDGE_RISING && !level ) || ( edge == EDGE_FALLING && level )) {
+                continue;
+            }
+            if( subscriber.pending.size() >= REMOTE_MAX_PENDING ) {
+                subscriber.pending.pop_front();
+                m_droppedEvents++;
+            }
+            subscriber.pending.push_back( event );
+        }
+    }
+
+    bool
+    GpioServer::sendEvents( Subscriber &subscriber ) {
+        // ---------------------------------------------------------------------------
+        // One event datagram is in flight per client. Edges that arrive meanwhile
+        // are coalesced into the next datagram, sent once the previous one is acked.
+        // Returns false once the datagram has been resent m_retries times.
+        // ---------------------------------------------------------------------------
+        const uint64_t now = nanoseconds();
+        if( !subscriber.inflight.empty()) {
+            if( now - subscriber.sentAt >= static_cast<uint64_t>( m_retransmit ) * 1000000ull ) {
+                if( subscriber.resends >= m_retries ) {
+                    return false;
+                }
+                sendTo( &subscriber.inflight[0], subscriber.inflight.size(), subscriber.address );
+                subscriber.sentAt = now;
+                subscriber.resends++;
+            }
+            return true;
+        }
+        if( subscriber.pending.empty()) {
+            return true;
+        }
+        const size_t count = subscriber.pending.size() < REMOTE_MAX_EVENTS ? subscriber.pending.size() : REMOTE_MAX_EVENTS;
+        subscriber.sequence++;
+        writeHeader( subscriber.inflight, TYPE_EVENT, subscriber.sequence, count, EVENT_SIZE, subscriber.epoch );
+        for( size_t ii = 0; ii < count; ii++ ) {
+            uint8_t *pp = &subscriber.inflight[HEADER_SIZE + ii * EVENT_SIZE];
+            put64( pp, subscriber.pending[ii].timestamp );
+            pp[8]  = subscriber.pending[ii].pin;
+            pp[9]  = subscriber.pending[ii].level;
+            pp[10] = 0;
+            pp[11] = 0;
+        }
+        subscriber.pending.erase( subscriber.pending.begin(), subscriber.pending.begin() + count );
+        sendTo( &subscriber.inflight[0], subscriber.inflight.size(), subscriber.address );
+        subscriber.sentAt  = now;
+        subscriber.resends = 0;
+        return true;
+    }
+
+    STATUS
+    GpioServer::pinWrite( GPIO_ID id, bool value ) {
+        if( m_inputs.count( id ) > 0 ) {
+            return STATUS_INTERNAL_BAD_ARG;     // Configured as an input.
+        }
+        GpioOutput *&output = m_outputs[id];
+        if( output == 0 ) {
+            output = openOutput( id );
+        }
+        if( !output->ok()) {
+            const STATUS status = output->getStatus();
+            delete output;
+            m_outputs.erase( id );
+            return status;
+        }
+        output->write( value );
+        return output->getStatus();
+    }
+
+    STATUS
+    GpioServer::pinRead( GPIO_ID id, bool &value ) {
+        if( m_outputs.count( id ) > 0 ) {
+            return STATUS_INTERNAL_BAD_ARG;     // Configured as an output.
+        }
+        // ---------------------------------------------------------------------------
+        // A failed input is opened again on the next read, unless it has edges
+        // armed: clients are waiting on its descriptor, so the read is retried.
+        // ---------------------------------------------------------------------------
+        GpioInput *&input = m_inputs[id];
+        if( input == 0 ) {
+            input = openInput( id );
+        }
+        std::map<int, EDGE>::const_iterator edge = m_edges.find( id );
+        if( !input->ok() && ( edge == m_edges.end() || edge->second == EDGE_NONE )) {
+            const STATUS status = input->getStatus();
+            delete input;
+            m_inputs.erase( id );
+            m_edges.erase( id );
+            return status;
+        }
+        input->read( value );
+        return input->getStatus();
+    }
+
+    STATUS
+    GpioServer::pinSetEdge( GPIO_ID id, EDGE edge ) {
+        bool value;
+        const STATUS status = pinRead( id, value );   // Makes sure the pin is an input.
+        if( status != STATUS_OK ) {
+            return status;
+        }
+        GpioInput *input = m_inputs.find( id )->second;  // pinRead() succeeded, so it is open.
+        if( !input->setEdge( edge )) {
+            return input->getStatus();
+        }
+        m_edges[id] = edge;
+        input->read( value );                       // Clear any edge that is already pending.
+        return input->getStatus();
+    }
+
+    STATUS
+    GpioServer::pinGetEdge( GPIO_ID id, EDGE &edge ) {
+        std::map<int, GpioInput*>::iterator found = m_inputs.find( id );
+        if( found == m_inputs.end()) {
+            edge = EDGE_NONE;
+            return STATUS_OK;
+        }
+        found->second->getEdge( edge );
+        return found->second->getStatus();
+    }
+
+    GpioInput*
+    GpioServer::openInput( GPIO_ID id ) {
+        return new GpioInput( id );
+    }
+
+    GpioOutput*
+    GpioServer::openOutput( GPIO_ID id ) {
+        return new GpioOutput( id );
+    }
+
+    void
+    GpioServer::edgeDescriptors( std::vector<struct pollfd> &fds ) {
+        // sysfs signals an edge as an exceptional condition on the value file.
+        for( std::map<int, EDGE>::const_iterator it = m_edges.begin(); it != m_edges.end(); ++it ) {
+            std::map<int, GpioInput*>::const_iterator input = m_inputs.find( it->first );
+            if( it->second == EDGE_NONE || input == m_inputs.end()) {
+                continue;
+            }
+            struct pollfd fd;
+            fd.fd      = input->second->getFileDescriptor();
+            fd.events  = POLLPRI | POLLERR;
+            fd.revents = 0;
+            fds.push_back( fd );
+        }
+    }
+
+    void
+    GpioServer::edgeReady( const struct pollfd &fd ) {
+        for( std::map<int, EDGE>::const_iterator it = m_edges.begin(); it != m_edges.end(); ++it ) {
+            std::map<int, GpioInput*>::iterator input = m_inputs.find( it->first );
+            bool value;
+            if( input != m_inputs.end() && input->second->getFileDescriptor() == fd.fd ) {
+                if( input->second->read( value )) {
+                    pushEdge( input->second->getId(), value, nanoseconds());
+                }
+                return;
+            }
+        }
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Remote GPIO client
+// ---------------------------------------------------------------------------
+
+    RemoteGpio::RemoteGpio( const char *host, uint16_t port ):
+    m_status( STATUS_OK ),
+    m_socket( CLOSED_FD ),
+    m_session( randomSession()),
+    m_sequence( 0 ),
+    m_eventEpoch( 0 ),
+    m_eventSequence( 0 ),
+    m_eventSeen( false ),
+    m_timeout( 100 ),
+    m_retries( 3 ),
+    m_buffer( DATAGRAM_SIZE ) {
+        memset( &m_server, 0, sizeof( m_server ));
+        if( host == 0 || *host == 0 ) {
+            setStatus( STATUS_INTERNAL_BAD_ARG );
+            return;
+        }
+        struct addrinfo hints;
+        memset( &hints, 0, sizeof( hints ));
+        hints.ai_family   = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        struct addrinfo *result = 0;
+        if( getaddrinfo( host, 0, &hints, &result ) != 0 || result == 0 ) {
+            setStatus( STATUS_ERROR_NETWORK );
+            return;
+        }
+        memcpy( &m_server, result->ai_addr, sizeof( m_server ));
+        freeaddrinfo( result );
+        m_server.sin_port = htons( port );
+
+        m_socket = socket( AF_INET, SOCK_DGRAM, 0 );
+        if( m_socket < 0 || connect( m_socket, reinterpret_cast<struct sockaddr*>( &m_server ), sizeof( m_server )) < 0 ) {
+            setStatus( STATUS_ERROR_NETWORK );
+        }
+    }
+
+    RemoteGpio::~RemoteGpio( void ) {
+        if( m_socket >= 0 ) {
+            ::close( m_socket );
+        }
+    }
+
+    void
+    RemoteGpio::setTimeout( long milliseconds, int retries ) {
+        m_timeout = milliseconds > 0 ? milliseconds : 1;
+        m_retries = retries > 0 ? retries : 0;
+    }
+
+    const RemoteStats&
+    RemoteGpio::getStats( void ) const {
+        return m_stats;
+    }
+
+    bool
+    RemoteGpio::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+    STATUS
+    RemoteGpio::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    RemoteGpio::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    RemoteGpio::setStatus( STATUS status ) {
+        m_status = status;
+        return m_status == STATUS_OK;
+    }
+
+    bool
+    RemoteGpio::receive( long milliseconds, uint32_t sequence, RemoteOp *ops, size_t count, bool &replied ) {
+        // ---------------------------------------------------------------------------
+        // Wait up to milliseconds for one datagram. A reply to sequence is copied
+        // into ops. Event datagrams are acked and queued; repeats are acked only.
+        // Returns true for success, including a timeout, false for a socket error.
+        // ---------------------------------------------------------------------------
+        struct pollfd fd;
+        fd.fd      = m_socket;
+        fd.events  = POLLIN;
+        fd.revents = 0;
+        const int rc = ::poll( &fd, 1, static_cast<int>( milliseconds ));
+        if( rc < 0 ) {
+            return errno == EINTR ? true : setStatus( STATUS_ERROR_NETWORK );
+        }
+        if( rc == 0 ) {
+            return true;
+        }
+        const ssize_t length = recv( m_socket, &m_buffer[0], m_buffer.size(), 0 );
+        if( length < 0 ) {
+            // ECONNREFUSED: nothing listening yet, treat it like a lost datagram.
+            return errno == ECONNREFUSED || errno == EINTR ? true : setStatus( STATUS_ERROR_NETWORK );
+        }
+        uint8_t  type;
+        uint32_t seq;
+        size_t   items;
+        uint16_t epoch;
+        if( !readHeader( &m_buffer[0], length, type, seq, items, epoch )) {
+            return true;
+        }
+        if( type == TYPE_REPLY ) {
+            if( seq == sequence && items == count && static_cast<size_t>( length ) >= HEADER_SIZE + count * OP_SIZE ) {
+                for( size_t ii = 0; ii < count; ii++ ) {
+                    getOp( &m_buffer[HEADER_SIZE + ii * OP_SIZE], ops[ii] );
+                }
+                replied = true;
+            }
+            return true;
+        }
+        if( type == TYPE_EVENT && static_cast<size_t>( length ) >= HEADER_SIZE + items * EVENT_SIZE ) {
+            std::vector<uint8_t> ack;
+            writeHeader( ack, TYPE_EVENT_ACK, seq, 0, 0, epoch );
+            send( m_socket, &ack[0], ack.size(), 0 );
+            if( m_eventSeen && epoch == m_eventEpoch && static_cast<int32_t>( seq - m_eventSequence ) <= 0 ) {
+                return true;            // Retransmit of a datagram we already have.
+            }
+            m_eventSeen     = true;     // A new epoch is a new subscription, its sequences start again.
+            m_eventEpoch    = epoch;
+            m_eventSequence = seq;
+            for( size_t ii = 0; ii < items; ii++ ) {
+                const uint8_t *pp = &m_buffer[HEADER_SIZE + ii * EVENT_SIZE];
+                RemoteEvent event;
+                event.timestamp = get64( pp );
+                event.pin       = pp[8];
+                event.level     = pp[9];
+                m_events.push_back( event );
+            }
+            m_stats.events += items;
+        }
+        return true;
+    }
+
+    bool
+    RemoteGpio::transfer( RemoteOp *ops, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Send all of the operations in one request and wait for the reply,
+        // resending after each timeout. Per operation results are in ops[ii].status.
+        // Returns true if the reply arrived, false otherwise.
+        // ---------------------------------------------------------------------------
+        if( ops == 0 || count == 0 || count > REMOTE_MAX_OPS ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        if( m_socket < 0 ) {
+            return setStatus( STATUS_ERROR_NETWORK );
+        }
+        const uint32_t sequence = ++m_sequence;
+        writeHeader( m_request, TYPE_REQUEST, sequence, count, OP_SIZE, m_session );
+        for( size_t ii = 0; ii < count; ii++ ) {
+            ops[ii].status = STATUS_OK;
+            putOp( &m_request[HEADER_SIZE + ii * OP_SIZE], ops[ii] );
+        }
+        const uint64_t start = nanoseconds();
+        for( int attempt = 0; attempt <= m_retries; attempt++ ) {
+            if( attempt > 0 ) {
+                m_stats.retransmits++;
+            }
+            if( send( m_socket, &m_request[0], m_request.size(), 0 ) < 0 && errno != ECONNREFUSED ) {
+                return setStatus( STATUS_ERROR_NETWORK );
+            }
+            const uint64_t deadline = nanoseconds() + static_cast<uint64_t>( m_timeout ) * 1000000ull;
+            bool replied = false;
+            while( !replied ) {
+                const uint64_t now = nanoseconds();
+                if( now >= deadline ) {
+                    break;
+                }
+                const long remaining = static_cast<long>(( deadline - now + 999999 ) / 1000000 );
+                if( !receive( remaining, sequence, ops, count, replied )) {
+                    return false;
+                }
+            }
+            if( replied ) {
+                m_stats.roundTrips++;
+                m_stats.operations  += count;
+                m_stats.nanoseconds += nanoseconds() - start;
+                return setStatus( STATUS_OK );
+            }
+        }
+        return setStatus( STATUS_TIMEOUT );
+    }
+
+    void
+    RemoteGpio::queueWrite( GPIO_ID id, bool value ) {
+        for( size_t ii = 0; ii < m_queue.size(); ii++ ) {
+            if( m_queue[ii].pin == id ) {
+                m_queue[ii].value = value ? 1 : 0;
+                m_stats.coalesced++;
+                return;
+            }
+        }
+        if( m_queue.size() >= REMOTE_MAX_OPS ) {
+            flush();
+        }
+        m_queue.push_back( RemoteOp( REMOTE_OP_WRITE, id, value ? 1 : 0 ));
+    }
+
+    size_t
+    RemoteGpio::queued( void ) const {
+        return m_queue.size();
+    }
+
+    bool
+    RemoteGpio::flush( void ) {
+        // ---------------------------------------------------------------------------
+        // Send the queued writes. Returns false if the round trip or any write failed.
+        // ---------------------------------------------------------------------------
+        if( m_queue.empty()) {
+            return setStatus( STATUS_OK );
+        }
+        const bool sent = transfer( &m_queue[0], m_queue.size());
+        STATUS status = m_status;
+        for( size_t ii = 0; sent && ii < m_queue.size(); ii++ ) {
+            if( m_queue[ii].status != STATUS_OK ) {
+                status = static_cast<STATUS>( m_queue[ii].status );
+            }
+        }
+        m_queue.clear();
+        return setStatus( status );
+    }
+
+    bool
+    RemoteGpio::waitEvent( GPIO_ID id, RemoteEvent &event, long milliseconds ) {
+        // ---------------------------------------------------------------------------
+        // Take the oldest pushed edge for pin id, waiting up to milliseconds for one.
+        // Returns true for an edge, false on timeout (STATUS_TIMEOUT) or error.
+        // ---------------------------------------------------------------------------
+        const uint64_t deadline = nanoseconds() + static_cast<uint64_t>( milliseconds > 0 ? milliseconds : 0 ) * 1000000ull;
+        bool replied = false;
+        while( true ) {
+            for( std::deque<RemoteEvent>::iterator it = m_events.begin(); it != m_events.end(); ++it ) {
+                if( it->pin == id ) {
+                    event = *it;
+                    m_events.erase( it );
+                    return setStatus( STATUS_OK );
+                }
+            }
+            const uint64_t now = nanoseconds();
+            const long remaining = now >= deadline ? 0 : static_cast<long>(( deadline - now + 999999 ) / 1000000 );
+            const size_t before = m_events.size();
+            if( !receive( remaining, 0, 0, 0, replied )) {
+                return false;
+            }
+            if( remaining == 0 && m_events.size() == before ) {
+                return setStatus( STATUS_TIMEOUT );
+            }
+        }
+    }
+
+    size_t
+    RemoteGpio::pendingEvents( void ) const {
+        return m_events.size();
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - Remote GPIO input & output
+// ---------------------------------------------------------------------------
+
+    RemoteGpioInput::RemoteGpioInput( RemoteGpio &remote, GPIO_ID id ):
+    m_remote( remote ),
+    m_id( id ),
+    m_status( remote.getStatus()) {
+    }
+
+    GPIO_ID
+    RemoteGpioInput::getId( void ) const {
+        return m_id;
+    }
+
+    bool
+    RemoteGpioInput::single( RemoteOp &op ) {
+        if( !m_remote.transfer( &op, 1 )) {
+            m_status = m_remote.getStatus();
+        } else {
+            m_status = static_cast<STATUS>( op.status );
+        }
+        return m_status == STATUS_OK;
+    }
+
+    bool
+    RemoteGpioInput::setEdge( const EDGE edge ) {
+        RemoteOp op( REMOTE_OP_SET_EDGE, m_id, static_cast<uint8_t>( edge ));
+        return single( op );
+    }
+
+    bool
+    RemoteGpioInput::getEdge( EDGE &edge ) {
+        RemoteOp op( REMOTE_OP_GET_EDGE, m_id );
+        if( !single( op )) {
+            return false;
+        }
+        edge = static_cast<EDGE>( op.value );
+        return true;
+    }
+
+    bool
+    RemoteGpioInput::read( bool &value ) {
+        RemoteOp op( REMOTE_OP_READ, m_id );
+        if( !single( op )) {
+            return false;
+        }
+        value = op.value != 0;
+        return true;
+    }
+
+    bool
+    RemoteGpioInput::read_wait( bool &value, long seconds, long milliseconds ) {
+        // ---------------------------------------------------------------------------
+        // Wait for the server to push an edge on this pin, as set with setEdge().
+        // The value is the level the server read when the edge happened.
+        // ---------------------------------------------------------------------------
+        if( seconds < 0 ) {
+            seconds = 0;
+        }
+        if( milliseconds < 0 ) {
+            milliseconds = 0;
+        }
+        if( seconds == 0 && milliseconds == 0 ) {
+            return read( value );
+        }
+        RemoteEvent event;
+        if( !m_remote.waitEvent( m_id, event, seconds * 1000 + milliseconds )) {
+            m_status = m_remote.getStatus();
+            return false;
+        }
+        value    = event.level != 0;
+        m_status = STATUS_OK;
+        return true;
+    }
+
+    STATUS
+    RemoteGpioInput::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    RemoteGpioInput::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    RemoteGpioInput::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+    RemoteGpioOutput::RemoteGpioOutput( RemoteGpio &remote, GPIO_ID id ):
+    m_remote( remote ),
+    m_id( id ),
+    m_status( remote.getStatus()) {
+    }
+
+    GPIO_ID
+    RemoteGpioOutput::getId( void ) const {
+        return m_id;
+    }
+
+    bool
+    RemoteGpioOutput::write( bool value ) {
+        RemoteOp op( REMOTE_OP_WRITE, m_id, value ? 1 : 0 );
+        if( !m_remote.transfer( &op, 1 )) {
+            m_status = m_remote.getStatus();
+        } else {
+            m_status = static_cast<STATUS>( op.status );
+        }
+        return m_status == STATUS_OK;
+    }
+
+    void
+    RemoteGpioOutput::queue( bool value ) {
+        m_remote.queueWrite( m_id, value );
+    }
+
+    STATUS
+    RemoteGpioOutput::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    RemoteGpioOutput::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    RemoteGpioOutput::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+}   // namespace tfs
@@ -0,0 +1,269 @@
+// ---------------------------------------------------------------------------
+// remote.hpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Remote GPIO over UDP.
+//
+// GpioServer runs on the Pi that owns the pins. RemoteGpio is a client
+// connection to one server, and RemoteGpioInput / RemoteGpioOutput mirror
+// GpioInput / GpioOutput on top of it.
+//
+// Every datagram starts with a 12 byte header:
+//   uint16 magic, uint8 version, uint8 type, uint32 sequence, uint16 count, uint16 session
+// followed by count 4 byte operations (request, reply) or 12 byte edge
+// events (event). All values are little endian.
+//
+// A request carries any number of pin operations and is answered by one
+// reply with the same sequence number; the client retransmits on timeout
+// and the server answers a repeated sequence from its reply cache without
+// running the operations again. A request older than the last one from that
+// client is a late duplicate and is dropped. Each RemoteGpio picks a random
+// session; a request with a new session from the same address and port is
+// a restarted client, so the server forgets the old sequence & subscriptions.
+//
+// Edges on inputs with setEdge() are pushed to every client that set an edge
+// on the pin, coalesced into event datagrams that the client acks. The server
+// retransmits until acked, and forgets a client that stops acking. Event
+// sequences restart with each subscription, which has a new epoch in the
+// session field.
+// ---------------------------------------------------------------------------
+#ifndef remote_hpp
+#define remote_hpp
+
+#include <netinet/in.h>         // struct sockaddr_in
+#include <poll.h>               // struct pollfd
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+#include "gpio.hpp"
+
+namespace  tfs {
+
+    static const uint16_t REMOTE_GPIO_PORT   = 7027;
+    static const size_t   REMOTE_MAX_OPS     = 256;     // Per request, keeps a datagram under 1100 bytes.
+    static const size_t   REMOTE_MAX_EVENTS  = 64;      // Per event datagram.
+    static const size_t   REMOTE_MAX_PENDING = 1024;    // Per client, the oldest events are dropped beyond this.
+
+    enum REMOTE_OP {
+        REMOTE_OP_WRITE = 1,    // value: level
+        REMOTE_OP_READ,         // reply value: level
+        REMOTE_OP_SET_EDGE,     // value: EDGE, also subscribes the sender to edge events.
+        REMOTE_OP_GET_EDGE      // reply value: EDGE
+    };
+
+    struct RemoteOp {
+        uint8_t     code;       // REMOTE_OP
+        uint8_t     pin;        // GPIO_ID
+        uint8_t     value;
+        uint8_t     status;     // STATUS, filled in by the server.
+
+        RemoteOp( void );
+        RemoteOp( REMOTE_OP op, GPIO_ID id, uint8_t val = 0 );
+    };
+
+    struct RemoteEvent {
+        uint64_t    timestamp;  // Server CLOCK_MONOTONIC nanoseconds.
+        uint8_t     pin;        // GPIO_ID
+        uint8_t     level;
+    };
+
+    struct RemoteStats {
+        uint64_t    roundTrips;
+        uint64_t    retransmits;
+        uint64_t    operations;
+        uint64_t    coalesced;      // Queued writes replaced by a later write to the same pin.
+        uint64_t    events;
+        uint64_t    nanoseconds;    // Total round trip time.
+
+        RemoteStats( void );
+        double averageRoundTrip( void ) const;   // Nanoseconds
+    };
+
+    class GpioServer {
+    protected:
+        struct Reply {                          // Last reply to one client, resent for a repeated request.
+            uint32_t                sequence;   // Highest request sequence seen.
+            uint16_t                session;    // Of that request.
+            std::vector<uint8_t>    datagram;
+            uint64_t                lastSeen;   // Nanoseconds of the last request.
+        };
+        struct Subscriber {                     // Edge events for one client.
+            struct sockaddr_in      address;
+            std::map<int, EDGE>     pins;       // Edges this client asked for, by GPIO_ID.
+            uint16_t                session;    // Client session that subscribed.
+            uint16_t                epoch;      // Sent with each event datagram.
+            uint32_t                sequence;   // Sequence of the datagram in flight.
+            std::deque<RemoteEvent> pending;    // Waiting for the datagram in flight to be acked.
+            std::vector<uint8_t>    inflight;   // Sent and not yet acked, empty if none.
+            uint64_t                sentAt;
+            int                     resends;    // Of the datagram in flight.
+        };
+
+        STATUS          m_status;
+        int             m_socket;
+        uint16_t        m_port;
+        long            m_retransmit;           // Milliseconds before an event datagram is resent.
+        int             m_retries;              // Resends before a client that does not ack is dropped.
+        long            m_expiry;               // Milliseconds before an idle client's reply cache is freed.
+        uint64_t        m_lastSweep;
+        uint16_t        m_epoch;                // For the next new subscriber.
+        std::atomic<bool>                 m_running;
+        std::atomic<size_t>               m_clientCount;
+        std::atomic<size_t>               m_subscriberCount;
+        std::atomic<uint64_t>             m_droppedEvents;
+        std::map<uint64_t, Reply>         m_replies;        // Keyed by client address & port.
+        std::map<uint64_t, Subscriber>    m_subscribers;
+        std::map<int, std::vector<uint64_t> > m_pinSubscribers; // GPIO_ID to subscriber keys.
+        std::map<int, GpioOutput*>        m_outputs;
+        std::map<int, GpioInput*>         m_inputs;
+        std::map<int, EDGE>               m_edges;
+        std::vector<struct pollfd>        m_fds;
+        std::vector<uint8_t>              m_buffer;
+
+    protected:
+        bool setStatus( STATUS status );
+
+        void receive( void );
+        void handleRequest( const uint8_t *datagram, size_t length, const struct sockaddr_in &from );
+        void handleEventAck( const uint8_t *datagram, size_t length, const struct sockaddr_in &from );
+        bool sendEvents( Subscriber &subscriber );  // Returns false once the client has stopped acking.
+        void pushEdge( GPIO_ID id, bool level, uint64_t timestamp );
+        STATUS subscribe( uint64_t key, const struct sockaddr_in &from, uint16_t session, GPIO_ID id, EDGE edge );
+        void   unsubscribe( uint64_t key );
+        EDGE   pinEdges( GPIO_ID id, uint64_t except ) const;  // Union of the edges subscribers want.
+        void   sweep( uint64_t now );           // Free idle reply caches.
+
+        virtual bool sendTo( const uint8_t *datagram, size_t length, const struct sockaddr_in &to );
+
+        // Pin access, overridden to serve something other than the local sysfs GPIO.
+        virtual STATUS pinWrite(   GPIO_ID id, bool  value );
+        virtual STATUS pinRead(    GPIO_ID id, bool &value );
+        virtual STATUS pinSetEdge( GPIO_ID id, EDGE  edge );
+        virtual STATUS pinGetEdge( GPIO_ID id, EDGE &edge );
+        virtual void   edgeDescriptors( std::vector<struct pollfd> &fds );  // Append descriptors to wait on.
+        virtual void   edgeReady( const struct pollfd &fd );               // A descriptor has an edge.
+
+        // Used by the pin access above, overridden to open something other than sysfs.
+        virtual GpioInput  *openInput(  GPIO_ID id );
+        virtual GpioOutput *openOutput( GPIO_ID id );
+
+    public:
+                 GpioServer( uint16_t port = REMOTE_GPIO_PORT );          // Port 0 picks a free port.
+        virtual ~GpioServer( void );
+
+        uint16_t getPort( void ) const;
+
+        // Call before run().
+        void setEventRetransmit( long milliseconds, int retries );     // Default 20 ms, 50 resends.
+        void setExpiry( long milliseconds );                           // Default 60 s.
+
+        // Safe from any thread:
+        size_t   getClients( void ) const;          // Clients with a cached reply.
+        size_t   getSubscribers( void ) const;      // Clients with edge events.
+        uint64_t getDroppedEvents( void ) const;    // Events dropped because a client fell behind.
+
+        bool serve( long milliseconds );        // Wait for and handle one round of requests & edges.
+        bool run(   void );                     // serve() until stop().
+        void stop(  void );
+
+        STATUS clearStatus( void );
+        STATUS getStatus( void ) const;
+        bool   ok( void ) const;
+    };
+
+    class RemoteGpio {                          // Client connection to one GpioServer.
+    protected:
+        STATUS          m_status;
+        int             m_socket;
+        struct sockaddr_in m_server;
+        uint16_t        m_session;              // Random, new for each connection.
+        uint32_t        m_sequence;             // Last request sequence.
+        uint16_t        m_eventEpoch;           // Subscription of the last event datagram.
+        uint32_t        m_eventSequence;        // Last event datagram received.
+        bool            m_eventSeen;
+        long            m_timeout;              // Milliseconds before a request is resent.
+        int             m_retries;
+        RemoteStats     m_stats;
+        std::vector<RemoteOp>    m_queue;       // Queued writes, one per pin.
+        std::deque<RemoteEvent>  m_events;      // Received, not yet taken.
+        std::vector<uint8_t>     m_request;
+        std::vector<uint8_t>     m_buffer;
+
+    protected:
+        bool setStatus( STATUS status );
+        bool receive( long milliseconds, uint32_t sequence, RemoteOp *ops, size_t count, bool &replied );
+
+    public:
+                 RemoteGpio( const char *host, uint16_t port = REMOTE_GPIO_PORT );
+        virtual ~RemoteGpio( void );
+
+        void setTimeout( long milliseconds, int retries = 3 );
+
+        bool transfer( RemoteOp *ops, size_t count );   // One round trip. Results are written back into ops.
+
+        void queueWrite( GPIO_ID id, bool value );      // Coalesced: a later write to a pin replaces an earlier one.
+        size_t queued( void ) const;
+        bool flush( void );                             // Send all queued writes in one round trip.
+
+        bool waitEvent( GPIO_ID id, RemoteEvent &event, long milliseconds );   // Next pushed edge for a pin.
+        size_t pendingEvents( void ) const;
+
+        const RemoteStats &getStats( void ) const;
+
+        STATUS clearStatus( void );
+        STATUS getStatus( void ) const;
+        bool   ok( void ) const;
+    };
+
+    class RemoteGpioInput {                     // Mirrors GpioInput
+    protected:
+        RemoteGpio &m_remote;
+        GPIO_ID     m_id;
+        STATUS      m_status;
+
+        bool single( RemoteOp &op );
+
+    public:
+        RemoteGpioInput( RemoteGpio &remote, GPIO_ID id );
+
+        GPIO_ID getId( void ) const;
+
+        bool setEdge( const EDGE  edge );       // Used with read_wait(), edges are pushed by the server.
+        bool getEdge(       EDGE &edge );
+
+        bool read( bool &value );
+        bool read_wait( bool &value, long seconds, long milliseconds = 0 );
+
+        STATUS clearStatus( void );
+        STATUS getStatus( void ) const;
+        bool   ok( void ) const;
+    };
+
+    class RemoteGpioOutput {                    // Mirrors GpioOutput
+    protected:
+        RemoteGpio &m_remote;
+        GPIO_ID     m_id;
+        STATUS      m_status;
+
+    public:
+        RemoteGpioOutput( RemoteGpio &remote, GPIO_ID id );
+
+        GPIO_ID getId( void ) const;
+
+        bool write( bool value );               // One round trip.
+        void queue( bool value );               // Sent with the next RemoteGpio::flush()
+
+        STATUS clearStatus( void );
+        STATUS getStatus( void ) const;
+        bool   ok( void ) const;
+    };
+
+}   // namespace tfs
+
+#endif // remote_hpp
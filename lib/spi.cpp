@@ -0,0 +1,431 @@
+// ---------------------------------------------------------------------------
+// spi.cpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Notes on the spidev userspace API:
+// https://www.kernel.org/doc/Documentation/spi/spidev
+// https://www.raspberrypi.org/documentation/hardware/raspberrypi/spi/README.md
+// ---------------------------------------------------------------------------
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include "spi.hpp"
+
+
+namespace  tfs {
+
+    static const int CLOSED_FD = -1;
+
+    static uint64_t nanoseconds( void ) {
+        struct timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return static_cast<uint64_t>( now.tv_sec ) * 1000000000ull + now.tv_nsec;
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - SPI segment & statistics
+// ---------------------------------------------------------------------------
+
+    SpiSegment::SpiSegment( void ):
+    tx( 0 ),
+    rx( 0 ),
+    length( 0 ),
+    delayUsecs( 0 ),
+    csChange( false ) {
+    }
+
+    SpiSegment::SpiSegment( const uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, bool deselect ):
+    tx( txBuffer ),
+    rx( rxBuffer ),
+    length( len ),
+    delayUsecs( 0 ),
+    csChange( deselect ) {
+    }
+
+    SpiStats::SpiStats( void ) {
+        clear();
+    }
+
+    void
+    SpiStats::clear( void ) {
+        messages       = 0;
+        segments       = 0;
+        bytes          = 0;
+        nanoseconds    = 0;
+        minNanoseconds = 0;
+        maxNanoseconds = 0;
+    }
+
+    double
+    SpiStats::bytesPerSecond( void ) const {
+        if( nanoseconds == 0 ) {
+            return 0.0;
+        }
+        return static_cast<double>( bytes ) * 1.0e9 / static_cast<double>( nanoseconds );
+    }
+
+    double
+    SpiStats::averageLatency( void ) const {
+        if( messages == 0 ) {
+            return 0.0;
+        }
+        return static_cast<double>( nanoseconds ) / static_cast<double>( messages );
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - SPI ring buffer
+// ---------------------------------------------------------------------------
+
+    SpiRing::SpiRing( size_t frameLength, size_t frames ):
+    m_data( frameLength * frames ),
+    m_frameLength( frameLength ),
+    m_frames( frames ),
+    m_head( 0 ),
+    m_tail( 0 ),
+    m_overruns( 0 ) {
+    }
+
+    size_t
+    SpiRing::frameLength( void ) const {
+        return m_frameLength;
+    }
+
+    size_t
+    SpiRing::capacity( void ) const {
+        return m_frames;
+    }
+
+    size_t
+    SpiRing::size( void ) const {
+        return m_head.load( std::memory_order_acquire ) - m_tail.load( std::memory_order_acquire );
+    }
+
+    size_t
+    SpiRing::overruns( void ) const {
+        return m_overruns.load( std::memory_order_relaxed );
+    }
+
+    uint8_t*
+    SpiRing::reserve( size_t &count ) {
+        // ---------------------------------------------------------------------------
+        // Producer: return the next writable frame and reduce count to the number of
+        // free frames that are contiguous from there. Returns 0 if the ring is full.
+        // ---------------------------------------------------------------------------
+        if( m_frames == 0 ) {
+            count = 0;
+            return 0;
+        }
+        const size_t head   = m_head.load( std::memory_order_relaxed );
+        const size_t tail   = m_tail.load( std::memory_order_acquire );
+        const size_t free   = m_frames - ( head - tail );
+        const size_t index  = head % m_frames;
+        const size_t toEnd  = m_frames - index;
+        if( count > free ) {
+            count = free;
+        }
+        if( count > toEnd ) {
+            count = toEnd;
+        }
+        if( count == 0 ) {
+            return 0;
+        }
+        return &m_data[index * m_frameLength];
+    }
+
+    void
+    SpiRing::commit( size_t count ) {
+        m_head.fetch_add( count, std::memory_order_release );
+    }
+
+    void
+    SpiRing::overrun( size_t count ) {
+        m_overruns.fetch_add( count, std::memory_order_relaxed );
+    }
+
+    bool
+    SpiRing::read( uint8_t *frame ) {
+        // ---------------------------------------------------------------------------
+        // Consumer: copy out the oldest frame.
+        // Returns true for success, false if the ring is empty.
+        // ---------------------------------------------------------------------------
+        const size_t tail = m_tail.load( std::memory_order_relaxed );
+        const size_t head = m_head.load( std::memory_order_acquire );
+        if( head == tail || frame == 0 ) {
+            return false;
+        }
+        const size_t index = tail % m_frames;
+        memcpy( frame, &m_data[index * m_frameLength], m_frameLength );
+        m_tail.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    void
+    SpiRing::clear( void ) {
+        // Only safe when the producer is not running.
+        m_tail.store( m_head.load( std::memory_order_acquire ), std::memory_order_release );
+        m_overruns.store( 0, std::memory_order_relaxed );
+    }
+
+// ---------------------------------------------------------------------------
+// #pragma mark - SPI device
+// ---------------------------------------------------------------------------
+
+    SpiDevice::SpiDevice( void ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_mode( SPI_MODE_0 ),
+    m_bits( 8 ),
+    m_speed( 1000000 ),
+    m_streaming( false ),
+    m_stopping( false ) {
+    }
+
+    SpiDevice::SpiDevice( int bus, int chipSelect, uint8_t mode, uint32_t speedHz, uint8_t bitsPerWord ):
+    m_status( STATUS_OK ),
+    m_fd( CLOSED_FD ),
+    m_mode( mode ),
+    m_bits( bitsPerWord ),
+    m_speed( speedHz ),
+    m_streaming( false ),
+    m_stopping( false ) {
+        std::stringstream path;
+        path << "/dev/spidev" << bus << "." << chipSelect;
+        m_path = path.str();
+        open();
+    }
+
+    SpiDevice::~SpiDevice( void ) {
+        close();
+    }
+
+    bool
+    SpiDevice::open( void ) {
+        // ---------------------------------------------------------------------------
+        // Open the spidev device and configure it once. Every transfer after this
+        // uses the device defaults, so segments never carry per-transfer overrides.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        m_fd = ::open( m_path.c_str(), O_RDWR );
+        if( m_fd < 0 ) {
+            return setStatus( STATUS_ERROR_FILE_OPEN );
+        }
+        if( ioctl( m_fd, SPI_IOC_WR_MODE,          &m_mode  ) < 0 ||
+            ioctl( m_fd, SPI_IOC_WR_BITS_PER_WORD, &m_bits  ) < 0 ||
+            ioctl( m_fd, SPI_IOC_WR_MAX_SPEED_HZ,  &m_speed ) < 0 ) {
+            close();
+            return setStatus( STATUS_ERROR_IOCTL );
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    void
+    SpiDevice::close( void ) {
+        if( m_fd >= 0 ) {
+            ::close( m_fd );
+            m_fd = CLOSED_FD;
+        }
+    }
+
+    const std::string&
+    SpiDevice::getPath( void ) const {
+        return m_path;
+    }
+
+    int
+    SpiDevice::getFileDescriptor( void ) const {
+        return m_fd;
+    }
+
+    uint8_t
+    SpiDevice::getMode( void ) const {
+        return m_mode;
+    }
+
+    uint8_t
+    SpiDevice::getBitsPerWord( void ) const {
+        return m_bits;
+    }
+
+    uint32_t
+    SpiDevice::getSpeed( void ) const {
+        return m_speed;
+    }
+
+    bool
+    SpiDevice::ok( void ) const {
+        return m_status == STATUS_OK;
+    }
+
+    STATUS
+    SpiDevice::clearStatus( void ) {
+        return m_status = STATUS_OK;
+    }
+
+    STATUS
+    SpiDevice::getStatus( void ) const {
+        return m_status;
+    }
+
+    bool
+    SpiDevice::setStatus( STATUS status ) {
+        m_status = status;
+        return m_status == STATUS_OK;
+    }
+
+    const SpiStats&
+    SpiDevice::getStats( void ) const {
+        return m_stats;
+    }
+
+    void
+    SpiDevice::clearStats( void ) {
+        m_stats.clear();
+    }
+
+    bool
+    SpiDevice::prepare( size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Make m_transfers hold count zeroed entries. The vector only grows, so after
+        // the first call of a given size there is no allocation on the transfer path.
+        // ---------------------------------------------------------------------------
+        if( count == 0 || count > SPI_MAX_SEGMENTS ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        if( m_transfers.size() < count ) {
+            m_transfers.resize( count );
+        }
+        memset( &m_transfers[0], 0, count * sizeof( struct spi_ioc_transfer ));
+        return true;
+    }
+
+    bool
+    SpiDevice::submit( struct spi_ioc_transfer *transfers, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Send all of the transfers to the driver in a single ioctl.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( m_fd < 0 ) {
+            return setStatus( STATUS_ERROR_FILE_OPEN );
+        }
+        if( ioctl( m_fd, SPI_IOC_MESSAGE( count ), transfers ) < 0 ) {
+            return setStatus( STATUS_ERROR_IOCTL );
+        }
+        return setStatus( STATUS_OK );
+    }
+
+    bool
+    SpiDevice::transfer( const SpiSegment *segments, size_t count ) {
+        // ---------------------------------------------------------------------------
+        // Transfer all of the segments as one message.
+        // Returns true for success, false for failure.
+        // ---------------------------------------------------------------------------
+        if( segments == 0 || !prepare( count )) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        uint64_t bytes = 0;
+        for( size_t ii = 0; ii < count; ii++ ) {
+            const SpiSegment &segment = segments[ii];
+            struct spi_ioc_transfer &xfer = m_transfers[ii];
+            xfer.tx_buf      = reinterpret_cast<uintptr_t>( segment.tx );
+            xfer.rx_buf      = reinterpret_cast<uintptr_t>( segment.rx );
+            xfer.len         = segment.length;
+            xfer.delay_usecs = segment.delayUsecs;
+            xfer.cs_change   = segment.csChange ? 1 : 0;
+            bytes += segment.length;
+        }
+        const uint64_t start = nanoseconds();
+        if( !submit( &m_transfers[0], count )) {
+            return false;
+        }
+        const uint64_t elapsed = nanoseconds() - start;
+        if( m_stats.messages == 0 || elapsed < m_stats.minNanoseconds ) {
+            m_stats.minNanoseconds = elapsed;
+        }
+        if( elapsed > m_stats.maxNanoseconds ) {
+            m_stats.maxNanoseconds = elapsed;
+        }
+        m_stats.messages    += 1;
+        m_stats.segments    += count;
+        m_stats.bytes       += bytes;
+        m_stats.nanoseconds += elapsed;
+        return true;
+    }
+
+    bool
+    SpiDevice::transfer( const uint8_t *tx, uint8_t *rx, uint32_t length ) {
+        const SpiSegment segment( tx, rx, length );
+        return transfer( &segment, 1 );
+    }
+
+    bool
+    SpiDevice::stream( const uint8_t *command, size_t framesPerMessage, SpiRing &ring, uint64_t maxMessages ) {
+        // ---------------------------------------------------------------------------
+        // Repeatedly send command (one ring frame long) and receive into the ring.
+        // The chip is deselected between frames so each frame is a new conversion.
+        // If the consumer falls behind, frames are sampled into a scratch area and
+        // counted as ring overruns, so the sample rate does not stall.
+        // Returns true when stopped or finished, false on a transfer error.
+        // ---------------------------------------------------------------------------
+        const size_t frameLength = ring.frameLength();
+        if( frameLength == 0 || framesPerMessage == 0 || framesPerMessage > SPI_MAX_SEGMENTS ) {
+            return setStatus( STATUS_INTERNAL_BAD_ARG );
+        }
+        std::vector<SpiSegment> segments( framesPerMessage, SpiSegment( command, 0, static_cast<uint32_t>( frameLength ), true ));
+        m_discard.resize( frameLength * framesPerMessage );
+        m_streaming.store( true );
+
+        uint64_t messages = 0;
+        while( !m_stopping.load( std::memory_order_relaxed ) && ( maxMessages == 0 || messages < maxMessages )) {
+            size_t   frames = framesPerMessage;
+            uint8_t *rx     = ring.reserve( frames );
+            const bool overrun = rx == 0;
+            if( overrun ) {
+                frames = framesPerMessage;
+                rx     = &m_discard[0];
+            }
+            for( size_t ii = 0; ii < frames; ii++ ) {
+                segments[ii].rx = rx + ii * frameLength;
+            }
+            segments[frames - 1].csChange = false;      // Release the chip at the end of the message.
+            const bool success = transfer( &segments[0], frames );
+            segments[frames - 1].csChange = true;
+            if( !success ) {
+                m_stopping.store( false );
+                m_streaming.store( false );
+                return false;
+            }
+            if( overrun ) {
+                ring.overrun( frames );
+            } else {
+                ring.commit( frames );
+            }
+            messages++;
+        }
+        m_stopping.store( false );
+        m_streaming.store( false );
+        return setStatus( STATUS_OK );
+    }
+
+    void
+    SpiDevice::stop( void ) {
+        m_stopping.store( true );
+    }
+
+    void
+    SpiDevice::clearStop( void ) {
+        m_stopping.store( false );
+    }
+
+    bool
+    SpiDevice::streaming( void ) const {
+        return m_streaming.load();
+    }
+
+}   // namespace tfs
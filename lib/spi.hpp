@@ -0,0 +1,146 @@
+// ---------------------------------------------------------------------------
+// spi.hpp
+//
+// Created by Barrett Davis on 10/12/16.
+// Copyright © 2016 Tree Frog Software. All rights reserved.
+// MIT License: https://github.com/barrettd/Raspberry-Pi-Cpp/blob/master/LICENSE
+// https://github.com/barrettd/Raspberry-Pi-Cpp.git
+// ---------------------------------------------------------------------------
+// Hardware SPI master using the Linux spidev driver.
+// https://www.kernel.org/doc/Documentation/spi/spidev
+// Enable with raspi-config (Interfacing Options -> SPI), which gives us:
+//   /dev/spidev0.0  SPI0 CE0 (GPIO_08)    /dev/spidev0.1  SPI0 CE1 (GPIO_07)
+// ---------------------------------------------------------------------------
+#ifndef spi_hpp
+#define spi_hpp
+
+#include <linux/spi/spidev.h>   // struct spi_ioc_transfer, SPI_MODE_0 .. SPI_MODE_3
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "gpio.hpp"             // STATUS
+
+namespace  tfs {
+
+    // -----------------------------------------------------------------------
+    // The ioctl size field is 14 bits, so one SPI_IOC_MESSAGE holds at most
+    // 511 transfers. Note that spidev also limits the total bytes of one
+    // message to its "bufsiz" module parameter (4096 by default.)
+    // -----------------------------------------------------------------------
+    static const size_t SPI_MAX_SEGMENTS = ((1 << _IOC_SIZEBITS) - 1) / sizeof( struct spi_ioc_transfer );
+
+    struct SpiSegment {                 // One piece of a multi-segment transfer. Buffers are owned by the caller.
+        const uint8_t  *tx;             // Bytes to send, or 0 to send zeros.
+        uint8_t        *rx;             // Bytes received, or 0 to discard.
+        uint32_t        length;         // Length of tx and rx in bytes.
+        uint16_t        delayUsecs;     // Delay after this segment, before the next one.
+        bool            csChange;       // Deselect the chip between this segment and the next.
+
+        SpiSegment( void );
+        SpiSegment( const uint8_t *txBuffer, uint8_t *rxBuffer, uint32_t len, bool deselect = false );
+    };
+
+    struct SpiStats {                   // Accumulated timing for SPI_IOC_MESSAGE calls.
+        uint64_t        messages;       // Number of ioctl() calls.
+        uint64_t        segments;       // Number of segments transferred.
+        uint64_t        bytes;          // Number of bytes clocked (each byte is both sent and received.)
+        uint64_t        nanoseconds;    // Total time spent in the ioctl() calls.
+        uint64_t        minNanoseconds; // Fastest single message.
+        uint64_t        maxNanoseconds; // Slowest single message.
+
+        SpiStats( void );
+        void   clear( void );
+        double bytesPerSecond(   void ) const;  // Throughput
+        double averageLatency(   void ) const;  // Mean nanoseconds per message.
+    };
+
+    class SpiRing {                     // Single producer, single consumer ring of fixed length frames.
+    protected:
+        std::vector<uint8_t> m_data;
+        size_t               m_frameLength;     // Bytes per frame.
+        size_t               m_frames;          // Capacity in frames.
+        std::atomic<size_t>  m_head;            // Total frames written.
+        std::atomic<size_t>  m_tail;            // Total frames read.
+        std::atomic<size_t>  m_overruns;        // Frames dropped because the ring was full.
+
+    public:
+        SpiRing( size_t frameLength, size_t frames );
+
+        size_t frameLength( void ) const;
+        size_t capacity(    void ) const;
+        size_t size(        void ) const;       // Frames available to read.
+        size_t overruns(    void ) const;
+
+        // Producer side:
+        uint8_t *reserve( size_t &count );      // Contiguous writable frames, count is reduced to what fits.
+        void     commit(  size_t count );       // Publish frames filled in after reserve().
+        void     overrun( size_t count );       // Record frames that were sampled but had no room.
+
+        // Consumer side:
+        bool     read( uint8_t *frame );        // Copy out the oldest frame. Returns false if empty.
+        void     clear( void );
+    };
+
+    class SpiDevice {
+    protected:
+        std::string     m_path;         // e.g. "/dev/spidev0.0"
+        STATUS          m_status;       // Status from the last operation.
+        int             m_fd;           // File descriptor for the spidev device.
+        uint8_t         m_mode;         // SPI_MODE_0 .. SPI_MODE_3
+        uint8_t         m_bits;         // Bits per word.
+        uint32_t        m_speed;        // Clock in Hz.
+        SpiStats        m_stats;
+        std::atomic<bool>                    m_streaming;   // stream() is running.
+        std::atomic<bool>                    m_stopping;    // Set by stop(), consumed when stream() returns.
+        std::vector<struct spi_ioc_transfer> m_transfers;   // Reused for every message, no allocation per call.
+        std::vector<uint8_t>                 m_discard;     // Receive area for frames that overrun the ring.
+
+    protected:
+        SpiDevice( void );                      // No device opened; for subclasses that override submit().
+
+        bool setStatus( STATUS status );        // Set the status and return: status == STATUS_OK
+
+        bool open(  void );                     // Open m_path and configure mode, bits and speed.
+        void close( void );
+
+        bool prepare( size_t count );           // Size m_transfers for count segments.
+        virtual bool submit( struct spi_ioc_transfer *transfers, size_t count ); // One SPI_IOC_MESSAGE ioctl.
+
+    public:
+                 SpiDevice( int bus, int chipSelect, uint8_t mode = SPI_MODE_0, uint32_t speedHz = 1000000, uint8_t bitsPerWord = 8 );
+        virtual ~SpiDevice( void );
+
+        const std::string &getPath( void ) const;
+        int      getFileDescriptor( void ) const;
+        uint8_t  getMode(  void ) const;
+        uint8_t  getBitsPerWord( void ) const;
+        uint32_t getSpeed( void ) const;
+
+        bool transfer( const SpiSegment *segments, size_t count );  // All segments in one ioctl, chip selected throughout.
+        bool transfer( const uint8_t *tx, uint8_t *rx, uint32_t length );
+
+        // -------------------------------------------------------------------
+        // Continuous sampling: send the same command frame over and over,
+        // framesPerMessage frames per ioctl, receiving directly into ring.
+        // Runs until maxMessages have been sent (0 = no limit) or stop() is called.
+        // Typically run on its own std::thread while another thread reads the ring.
+        // A stop() before that thread reaches stream() is not lost: the stream
+        // returns at once. Call clearStop() to discard a stop made while idle.
+        // -------------------------------------------------------------------
+        bool stream( const uint8_t *command, size_t framesPerMessage, SpiRing &ring, uint64_t maxMessages = 0 );
+        void stop( void );
+        void clearStop( void );
+        bool streaming( void ) const;
+
+        const SpiStats &getStats( void ) const;
+        void  clearStats( void );
+
+        STATUS clearStatus( void );             // Set the status to STATUS_OK
+        STATUS getStatus( void ) const;         // Get the status
+        bool   ok( void ) const;                // Test if the status == STATUS_OK
+    };
+
+}   // namespace tfs
+
+#endif // spi_hpp
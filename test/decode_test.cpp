@@ -0,0 +1,346 @@
+// ---------------------------------------------------------------------------
+//  decode_test.cpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+// Every decode kernel this CPU supports is checked against the scalar
+// reference on a pseudo random capture, then the protocol decoders are run
+// on synthesized UART, SPI and I2C waveforms.
+// ---------------------------------------------------------------------------
+#include <ctime>
+#include <iostream>
+#include <string>
+#include "decode.hpp"
+#include "tests.hpp"
+
+namespace  tfs  {
+
+    static const DECODE_KERNEL KERNELS[] = { DECODE_SCALAR, DECODE_SSE2, DECODE_AVX2, DECODE_NEON };
+    static const size_t        KERNEL_COUNT = sizeof( KERNELS ) / sizeof( KERNELS[0] );
+
+    class Capture {                         // Builds a capture one level change at a time.
+    public:
+        std::vector<uint32_t> m_samples;
+        uint32_t              m_levels;
+
+        Capture( uint32_t levels ):
+        m_levels( levels ) {
+        }
+
+        void set( int pin, uint32_t level ) {
+            m_levels = ( m_levels & ~( 1u << pin )) | (( level & 1 ) << pin );
+        }
+
+        void hold( size_t samples ) {
+            m_samples.insert( m_samples.end(), samples, m_levels );
+        }
+    };
+
+    static void randomCapture( std::vector<uint32_t> &samples, size_t length, uint32_t seed, uint32_t rate ) {
+        // About rate samples in 65536 have a change, often on several pins at once.
+        samples.resize( length );
+        uint32_t levels = 0x0F0F0F0F;
+        for( size_t ii = 0; ii < length; ii++ ) {
+            seed = seed * 1664525u + 1013904223u;
+            if(( seed >> 16 ) < rate ) {
+                levels ^= ( seed & 0x00FFFFFF ) | (( seed & 0xFF ) << 24 );
+            }
+            samples[ii] = levels;
+        }
+    }
+
+    static bool sameEdges( const std::vector<PinEdge> &aa, const std::vector<PinEdge> &bb ) {
+        if( aa.size() != bb.size()) {
+            return false;
+        }
+        for( size_t ii = 0; ii < aa.size(); ii++ ) {
+            if( aa[ii].sample != bb[ii].sample || aa[ii].pin != bb[ii].pin || aa[ii].level != bb[ii].level ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool testKernels( void ) {
+        // ---------------------------------------------------------------------------
+        // Whole buffer, odd sized chunks and a pin mask must all match the reference.
+        // ---------------------------------------------------------------------------
+        std::vector<uint32_t> samples;
+        randomCapture( samples, 100003, 12345, 1500 );
+
+        EdgeDecoder reference( 0xFFFFFFFF, DECODE_SCALAR );
+        std::vector<PinEdge> expected;
+        reference.decode( &samples[0], samples.size(), expected );
+        EdgeDecoder maskedReference( 0x0000F00F, DECODE_SCALAR );
+        std::vector<PinEdge> expectedMasked;
+        maskedReference.decode( &samples[0], samples.size(), expectedMasked );
+
+        bool success = !expected.empty();
+        for( size_t kk = 0; kk < KERNEL_COUNT; kk++ ) {
+            if( !EdgeDecoder::supported( KERNELS[kk] )) {
+                continue;
+            }
+            const char *label = EdgeDecoder::name( KERNELS[kk] );
+
+            EdgeDecoder whole( 0xFFFFFFFF, KERNELS[kk] );
+            std::vector<PinEdge> edges;
+            if( whole.count( &samples[0], samples.size()) != expected.size() ||
+                whole.decode( &samples[0], samples.size(), edges ) != expected.size() || !sameEdges( edges, expected )) {
+                std::cerr << "decode " << label << " whole buffer mismatch\n";
+                success = false;
+            }
+
+            EdgeDecoder chunked( 0xFFFFFFFF, KERNELS[kk] );
+            edges.clear();
+            size_t offset = 0;
+            size_t chunk  = 1;
+            while( offset < samples.size()) {
+                const size_t length = offset + chunk < samples.size() ? chunk : samples.size() - offset;
+                chunked.decode( &samples[offset], length, edges );
+                offset += length;
+                chunk   = chunk * 3 + 1;
+                if( chunk > 5000 ) {
+                    chunk = 2;
+                }
+            }
+            if( !sameEdges( edges, expected ) || chunked.getInitialLevels() != samples[0] ) {
+                std::cerr << "decode " << label << " chunked mismatch\n";
+                success = false;
+            }
+
+            EdgeDecoder masked( 0x0000F00F, KERNELS[kk] );
+            edges.clear();
+            masked.decode( &samples[0], samples.size(), edges );
+            if( !sameEdges( edges, expectedMasked )) {
+                std::cerr << "decode " << label << " masked mismatch\n";
+                success = false;
+            }
+        }
+        return success;
+    }
+
+    static const double UART_SAMPLES_PER_BIT = 1000000.0 / 115200.0;  // 1 MHz capture of 115200 baud.
+
+    static void uartCapture( Capture &capture, const char *message ) {
+        capture.hold( 50 );
+        double clock = 50.0;
+        for( const char *cc = message; *cc != 0; cc++ ) {
+            const uint32_t frame = ( static_cast<uint8_t>( *cc ) << 1 ) | 0x200;   // Start, 8 data, stop.
+            for( int ii = 0; ii < 10; ii++ ) {
+                capture.set( GPIO_15, ( frame >> ii ) & 1 );
+                capture.set( GPIO_04, ii & 1 );                                 // Noise on another pin.
+                clock += UART_SAMPLES_PER_BIT;
+                capture.hold( static_cast<size_t>( clock ) - capture.m_samples.size());
+            }
+            capture.hold( 7 );
+            clock += 7;
+        }
+    }
+
+    static bool uartText( const std::vector<UartFrame> &frames, std::string &text ) {
+        text.clear();
+        for( size_t ii = 0; ii < frames.size(); ii++ ) {
+            if( frames[ii].framingError ) {
+                return false;
+            }
+            text += static_cast<char>( frames[ii].data );
+        }
+        return true;
+    }
+
+    static bool testUart( void ) {
+        const char *message = "Hello, Pi";
+        Capture capture( 0xFFFFFFFF );
+        uartCapture( capture, message );
+        EdgeDecoder decoder;
+        std::vector<PinEdge> edges;
+        decoder.decode( &capture.m_samples[0], capture.m_samples.size(), edges );
+        std::vector<UartFrame> frames;
+        std::string text;
+        decodeUart( edges, decoder.getInitialLevels(), GPIO_15, UART_SAMPLES_PER_BIT, decoder.getSampleCount(), frames );
+        if( !uartText( frames, text ) || text != message ) {
+            return false;
+        }
+        // ---------------------------------------------------------------------------
+        // Cut off in the middle of the last frame: that frame is not guessed at.
+        // ---------------------------------------------------------------------------
+        const size_t cut = capture.m_samples.size() - 7 - static_cast<size_t>( 4 * UART_SAMPLES_PER_BIT );
+        EdgeDecoder truncated;
+        edges.clear();
+        truncated.decode( &capture.m_samples[0], cut, edges );
+        frames.clear();
+        decodeUart( edges, truncated.getInitialLevels(), GPIO_15, UART_SAMPLES_PER_BIT, truncated.getSampleCount(), frames );
+        if( !uartText( frames, text ) || text != "Hello, P" ) {
+            std::cerr << "UART truncated capture decoded as \"" << text << "\"\n";
+            return false;
+        }
+        // ---------------------------------------------------------------------------
+        // In chunks that split frames, carrying unfinished frames across calls.
+        // ---------------------------------------------------------------------------
+        EdgeDecoder chunked;
+        UartDecoder uart( GPIO_15, UART_SAMPLES_PER_BIT );
+        frames.clear();
+        for( size_t offset = 0; offset < capture.m_samples.size(); offset += 37 ) {
+            const size_t length = offset + 37 < capture.m_samples.size() ? 37 : capture.m_samples.size() - offset;
+            edges.clear();
+            chunked.decode( &capture.m_samples[offset], length, edges );
+            if( offset == 0 ) {
+                uart.reset( chunked.getInitialLevels());
+            }
+            uart.decode( edges, chunked.getSampleCount(), frames );
+        }
+        if( !uartText( frames, text ) || text != message ) {
+            std::cerr << "UART chunked capture decoded as \"" << text << "\"\n";
+            return false;
+        }
+        // ---------------------------------------------------------------------------
+        // A low glitch shorter than half a bit on an idle line is not a start bit.
+        // ---------------------------------------------------------------------------
+        Capture glitch( 0xFFFFFFFF );
+        glitch.hold( 20 );
+        glitch.set( GPIO_15, 0 );
+        glitch.hold( 2 );
+        glitch.set( GPIO_15, 1 );
+        glitch.hold( 200 );
+        EdgeDecoder idle;
+        edges.clear();
+        idle.decode( &glitch.m_samples[0], glitch.m_samples.size(), edges );
+        frames.clear();
+        return edges.size() == 2 &&
+               decodeUart( edges, idle.getInitialLevels(), GPIO_15, UART_SAMPLES_PER_BIT, idle.getSampleCount(), frames ) == 0;
+    }
+
+    static bool testSpi( void ) {
+        // Mode 0: data changes while the clock is low, sampled on the rising edge.
+        const uint8_t mosi[3] = { 0x9F, 0x00, 0xA5 };
+        const uint8_t miso[3] = { 0xFF, 0xC2, 0x3C };
+        Capture capture( 1u << GPIO_08 );       // Chip select idle high, clock low.
+        capture.hold( 10 );
+        capture.set( GPIO_08, 0 );
+        capture.hold( 3 );
+        for( size_t bb = 0; bb < 3; bb++ ) {
+            for( int ii = 7; ii >= 0; ii-- ) {
+                capture.set( GPIO_11, 0 );
+                capture.set( GPIO_10, mosi[bb] >> ii );
+                capture.set( GPIO_09, miso[bb] >> ii );
+                capture.hold( 2 );
+                capture.set( GPIO_11, 1 );
+                capture.hold( 2 );
+            }
+        }
+        capture.set( GPIO_11, 0 );
+        capture.hold( 2 );
+        capture.set( GPIO_08, 1 );
+        capture.hold( 10 );
+
+        EdgeDecoder decoder;
+        std::vector<PinEdge> edges;
+        decoder.decode( &capture.m_samples[0], capture.m_samples.size(), edges );
+        std::vector<SpiFrame> frames;
+        decodeSpi( edges, decoder.getInitialLevels(), GPIO_11, GPIO_10, GPIO_09, GPIO_08, 0, frames );
+        if( frames.size() != 3 ) {
+            return false;
+        }
+        for( size_t bb = 0; bb < 3; bb++ ) {
+            if( frames[bb].mosi != mosi[bb] || frames[bb].miso != miso[bb] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void i2cByte( Capture &capture, uint8_t data, bool ack ) {
+        for( int ii = 8; ii >= 0; ii-- ) {
+            const uint32_t level = ii == 0 ? ( ack ? 0 : 1 ) : ( data >> ( ii - 1 )) & 1;
+            capture.set( GPIO_02, level );      // SDA changes while SCL is low.
+            capture.hold( 2 );
+            capture.set( GPIO_03, 1 );
+            capture.hold( 3 );
+            capture.set( GPIO_03, 0 );
+            capture.hold( 2 );
+        }
+    }
+
+    static bool testI2c( void ) {
+        Capture capture(( 1u << GPIO_02 ) | ( 1u << GPIO_03 ));    // Both lines idle high.
+        capture.hold( 10 );
+        capture.set( GPIO_02, 0 );              // START
+        capture.hold( 3 );
+        capture.set( GPIO_03, 0 );
+        capture.hold( 2 );
+        i2cByte( capture, 0x48 << 1, true );    // Address 0x48, write.
+        i2cByte( capture, 0x12, true );
+        i2cByte( capture, 0x34, false );
+        capture.set( GPIO_02, 0 );
+        capture.hold( 2 );
+        capture.set( GPIO_03, 1 );
+        capture.hold( 3 );
+        capture.set( GPIO_02, 1 );              // STOP
+        capture.hold( 10 );
+
+        EdgeDecoder decoder;
+        std::vector<PinEdge> edges;
+        decoder.decode( &capture.m_samples[0], capture.m_samples.size(), edges );
+        std::vector<I2cFrame> frames;
+        decodeI2c( edges, decoder.getInitialLevels(), GPIO_02, GPIO_03, frames );
+        return frames.size() == 5 &&
+               frames[0].event == I2C_EVENT_START &&
+               frames[1].event == I2C_EVENT_BYTE && frames[1].data == 0x90 && frames[1].ack &&
+               frames[2].event == I2C_EVENT_BYTE && frames[2].data == 0x12 && frames[2].ack &&
+               frames[3].event == I2C_EVENT_BYTE && frames[3].data == 0x34 && !frames[3].ack &&
+               frames[4].event == I2C_EVENT_STOP;
+    }
+
+    static void benchmark( void ) {
+        // ---------------------------------------------------------------------------
+        // Decode a 64 MB capture with each kernel and report input throughput.
+        // About one sample in a thousand has a change, typical of a bus capture
+        // taken well above the bit rate.
+        // ---------------------------------------------------------------------------
+        std::vector<uint32_t> samples;
+        randomCapture( samples, 16 * 1024 * 1024, 777, 64 );
+        std::vector<PinEdge> edges;
+        edges.reserve( samples.size() / 2 );
+        for( size_t kk = 0; kk < KERNEL_COUNT; kk++ ) {
+            if( !EdgeDecoder::supported( KERNELS[kk] )) {
+                continue;
+            }
+            EdgeDecoder decoder( 0xFFFFFFFF, KERNELS[kk] );
+            edges.clear();
+            struct timespec start, stop;
+            clock_gettime( CLOCK_MONOTONIC, &start );
+            decoder.decode( &samples[0], samples.size(), edges );
+            clock_gettime( CLOCK_MONOTONIC, &stop );
+            const double seconds = ( stop.tv_sec - start.tv_sec ) + ( stop.tv_nsec - start.tv_nsec ) * 1.0e-9;
+            const double bytes   = static_cast<double>( samples.size() * sizeof( uint32_t ));
+            std::cout << "decode " << EdgeDecoder::name( KERNELS[kk] ) << ": " << edges.size() << " edges, "
+                      << bytes / seconds / 1.0e9 << " GB/s\n";
+        }
+    }
+
+    bool decode_test( void ) {
+        std::cout << "Decode test start\n";
+        bool success = true;
+        if( !testKernels()) {
+            std::cerr << "Decode kernel test failed.\n";
+            success = false;
+        }
+        if( !testUart()) {
+            std::cerr << "Decode UART test failed.\n";
+            success = false;
+        }
+        if( !testSpi()) {
+            std::cerr << "Decode SPI test failed.\n";
+            success = false;
+        }
+        if( !testI2c()) {
+            std::cerr << "Decode I2C test failed.\n";
+            success = false;
+        }
+        benchmark();
+        std::cout << "Decode test " << ( success ? "complete" : "FAILED" ) << "\n";
+        return success;
+    }
+
+}   // namespace tfs
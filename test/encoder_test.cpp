@@ -0,0 +1,328 @@
+// ---------------------------------------------------------------------------
+//  encoder_test.cpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+// QuadratureEncoder and PulseCounter are driven by SimulatedEncoder, which
+// generates the edges a motor encoder on GPIO_17 (A) and GPIO_27 (B) would.
+// EdgeReader is fed kernel style line events through a pipe by PipeEdgeReader.
+// ---------------------------------------------------------------------------
+#include <linux/gpio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <thread>
+#include "encoder.hpp"
+#include "tests.hpp"
+
+namespace  tfs  {
+
+    static const GPIO_ID PIN_A = GPIO_17;
+    static const GPIO_ID PIN_B = GPIO_27;
+
+    class SimulatedEncoder {                // Gray code source, one edge per sample.
+    public:
+        uint32_t  m_state;                  // (A << 1) | B
+        uint64_t  m_sample;
+
+        SimulatedEncoder( void ):
+        m_state( 0 ),
+        m_sample( 0 ) {
+        }
+
+        void step( std::vector<PinEdge> &edges, bool forward ) {
+            // Forward is 00 -> 10 -> 11 -> 01 -> 00
+            static const uint32_t NEXT[4] = { 2, 0, 3, 1 };     // Forward successor of each state.
+            static const uint32_t PREV[4] = { 1, 3, 0, 2 };
+            const uint32_t next = forward ? NEXT[m_state] : PREV[m_state];
+            const uint32_t changed = next ^ m_state;
+            PinEdge edge;
+            edge.sample = m_sample++;
+            edge.pin    = static_cast<uint8_t>( changed == 2 ? PIN_A : PIN_B );
+            edge.level  = static_cast<uint8_t>(( next & changed ) != 0 ? 1 : 0 );
+            edges.push_back( edge );
+            m_state = next;
+        }
+    };
+
+    class PipeEdgeReader : public EdgeReader {  // Stands in for a GPIO line request.
+    public:
+        int m_write;
+
+        PipeEdgeReader( void ):
+        EdgeReader(),
+        m_write( -1 ) {
+            int fds[2];
+            if( pipe( fds ) != 0 ) {
+                setStatus( STATUS_ERROR_FILE_OPEN );
+                return;
+            }
+            m_fd    = fds[0];
+            m_write = fds[1];
+            fcntl( m_fd, F_SETFL, O_NONBLOCK );
+        }
+
+        virtual ~PipeEdgeReader( void ) {
+            ::close( m_write );
+        }
+
+        bool send( const PinEdge &edge, uint32_t sequence ) {
+            struct gpio_v2_line_event event;
+            memset( &event, 0, sizeof( event ));
+            event.timestamp_ns = edge.sample;
+            event.id           = edge.level != 0 ? GPIO_V2_LINE_EVENT_RISING_EDGE : GPIO_V2_LINE_EVENT_FALLING_EDGE;
+            event.offset       = edge.pin;
+            event.seqno        = sequence;
+            return ::write( m_write, &event, sizeof( event )) == static_cast<ssize_t>( sizeof( event ));
+        }
+    };
+
+    static bool testReader( void ) {
+        // ---------------------------------------------------------------------------
+        // 500 queued edges come back from one read() call, in order, with the
+        // two the "kernel" dropped counted. Nothing queued is a timeout.
+        // ---------------------------------------------------------------------------
+        SimulatedEncoder source;
+        std::vector<PinEdge> steps;
+        for( int ii = 0; ii < 502; ii++ ) {
+            source.step( steps, true );
+            steps.back().sample = 1000000 + ii * 1000;          // Nanoseconds, 1 MHz edges.
+        }
+        PipeEdgeReader reader;
+        for( uint32_t ii = 0; ii < steps.size(); ii++ ) {
+            if( ii != 100 && ii != 101 && !reader.send( steps[ii], ii + 1 )) {
+                return false;
+            }
+        }
+        std::vector<PinEdge> edges;
+        if( !reader.read( edges, 100 ) || edges.size() != 500 || reader.getDropped() != 2 ||
+            edges[0].sample != steps[0].sample || edges[499].pin != steps[501].pin || edges[499].level != steps[501].level ) {
+            emitStatus( "Edge reader", reader.getStatus());
+            return false;
+        }
+        if( reader.read( edges, 10 ) || reader.getStatus() != STATUS_TIMEOUT || edges.size() != 500 ) {
+            return false;
+        }
+        // The two edges after the gap are to levels the pins already have: two
+        // errors, and those four steps are not counted.
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( reader.getInitialLevels());
+        encoder.process( &edges[0], edges.size());
+        return encoder.getErrors() == 2 && encoder.getCount() == 498;
+    }
+
+    static bool testStopped( void ) {
+        // ---------------------------------------------------------------------------
+        // Once the edges stop, the rate falls off as time passes.
+        // ---------------------------------------------------------------------------
+        SimulatedEncoder source;
+        std::vector<PinEdge> edges;
+        for( int ii = 0; ii < 100; ii++ ) {
+            source.step( edges, true );
+        }
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( 0 );
+        encoder.setSamplePeriod( 1000.0 );                      // One edge per microsecond.
+        encoder.process( &edges[0], edges.size());
+        if( encoder.getRate() != 1.0e6 ) {
+            return false;
+        }
+        encoder.advance( edges.back().sample + 1 );             // Sooner than the next edge is due.
+        if( encoder.getRate() != 1.0e6 ) {
+            return false;
+        }
+        encoder.advance( edges.back().sample + 1000 );          // A millisecond with no edges.
+        if( encoder.getRate() != 1.0e3 || encoder.getInterval() != 1000 ) {
+            return false;
+        }
+        PulseCounter pulses( GPIO_22 );
+        pulses.reset( 0 );
+        for( uint64_t ii = 0; ii < 20; ii++ ) {
+            PinEdge edge;
+            edge.sample = ii * 500;                             // 1 kHz in nanoseconds.
+            edge.pin    = GPIO_22;
+            edge.level  = static_cast<uint8_t>(( ii & 1 ) == 0 ? 1 : 0 );
+            pulses.process( &edge, 1 );
+        }
+        if( pulses.getFrequency() != 1.0e6 ) {
+            return false;
+        }
+        pulses.advance( 9000 + 1000000000 );                    // A second after the last pulse.
+        return pulses.getFrequency() == 1.0 && pulses.getCount() == 10;
+    }
+
+    static bool testDirection( void ) {
+        SimulatedEncoder source;
+        std::vector<PinEdge> edges;
+        for( int ii = 0; ii < 1000; ii++ ) {
+            source.step( edges, true );
+        }
+        for( int ii = 0; ii < 250; ii++ ) {
+            source.step( edges, false );
+        }
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( 0 );
+        encoder.setSamplePeriod( 1000.0 );  // One edge per microsecond.
+        if( encoder.process( &edges[0], edges.size()) != edges.size()) {
+            return false;
+        }
+        return encoder.getCount() == 750 && encoder.getErrors() == 0 &&
+               encoder.getTransitions() == 1250 &&
+               encoder.getInterval() == -1000 && encoder.getRate() == -1.0e6;
+    }
+
+    static bool testErrors( void ) {
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( 0 );
+        PinEdge edges[5];
+        edges[0].sample = 10; edges[0].pin = PIN_A;   edges[0].level = 1;    // 00 -> 10, +1
+        edges[1].sample = 11; edges[1].pin = PIN_A;   edges[1].level = 0;    // 10 -> 00, -1
+        edges[2].sample = 12; edges[2].pin = GPIO_04; edges[2].level = 1;    // Not ours.
+        edges[3].sample = 13; edges[3].pin = PIN_A;   edges[3].level = 1;    // Both at once: illegal.
+        edges[4].sample = 13; edges[4].pin = PIN_B;   edges[4].level = 1;
+        if( encoder.process( edges, 5 ) != 4 || encoder.getCount() != 0 || encoder.getErrors() != 1 ) {
+            return false;
+        }
+        PinEdge again;                                                          // Already high: missed edge.
+        again.sample = 14; again.pin = PIN_B; again.level = 1;
+        encoder.process( &again, 1 );
+        return encoder.getErrors() == 2 && encoder.getCount() == 0;
+    }
+
+    static bool testCapture( void ) {
+        // ---------------------------------------------------------------------------
+        // From raw samples through EdgeDecoder, as a bulk capture would be handled.
+        // ---------------------------------------------------------------------------
+        SimulatedEncoder source;
+        std::vector<PinEdge> steps;
+        for( int ii = 0; ii < 400; ii++ ) {
+            source.step( steps, ii < 300 );
+        }
+        std::vector<uint32_t> samples;
+        uint32_t levels = 0;
+        for( size_t ii = 0; ii < steps.size(); ii++ ) {
+            levels = ( levels & ~( 1u << steps[ii].pin )) | ( static_cast<uint32_t>( steps[ii].level ) << steps[ii].pin );
+            samples.insert( samples.end(), 5, levels );         // Oversampled five times.
+            levels ^= 1u << GPIO_04;                            // Another pin toggling throughout.
+        }
+        samples.insert( samples.begin(), 0 );
+        EdgeDecoder decoder;
+        std::vector<PinEdge> edges;
+        decoder.decode( &samples[0], samples.size(), edges );
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( decoder.getInitialLevels());
+        encoder.process( &edges[0], edges.size());
+        return encoder.getCount() == 200 && encoder.getErrors() == 0;
+    }
+
+    static bool testPulses( void ) {
+        std::vector<PinEdge> edges;
+        for( uint64_t ii = 0; ii < 200; ii++ ) {                // 100 pulses, 10 samples each.
+            PinEdge edge;
+            edge.sample = ii * 5;
+            edge.pin    = GPIO_22;
+            edge.level  = static_cast<uint8_t>(( ii & 1 ) == 0 ? 1 : 0 );
+            edges.push_back( edge );
+        }
+        PulseCounter rising( GPIO_22, EDGE_RISING );
+        rising.reset( 0 );
+        rising.setSamplePeriod( 100.0 );                        // 10 MHz capture: a 1 MHz pulse train.
+        PulseCounter both( GPIO_22, EDGE_BOTH );
+        both.reset( 0 );
+        if( rising.process( &edges[0], edges.size()) != 200 || both.process( &edges[0], edges.size()) != 200 ) {
+            return false;
+        }
+        if( rising.getCount() != 100 || both.getCount() != 200 || rising.getErrors() != 0 ||
+            rising.getInterval() != 1000 || rising.getFrequency() != 1.0e6 ) {
+            return false;
+        }
+        rising.process( &edges[1], 1 );                         // Falling again while low: missed edge.
+        return rising.getErrors() == 1 && rising.getCount() == 100;
+    }
+
+    static bool benchmark( void ) {
+        // ---------------------------------------------------------------------------
+        // Feed 10 million simulated edges in batches of 512 on one thread while
+        // another thread reads the count. The count must never go backwards
+        // and must end exactly at the number of edges.
+        // ---------------------------------------------------------------------------
+        const size_t total = 10000000;
+        const size_t batch = 512;
+        SimulatedEncoder source;
+        std::vector<PinEdge> edges;
+        edges.reserve( total );
+        for( size_t ii = 0; ii < total; ii++ ) {
+            source.step( edges, true );
+        }
+        QuadratureEncoder encoder( PIN_A, PIN_B );
+        encoder.reset( 0 );
+        encoder.setSamplePeriod( 5000.0 );                      // 200k edges/s of simulated time.
+
+        std::atomic<bool> done( false );
+        bool monotonic = true;
+        uint64_t reads = 0;
+        std::thread reader( [&]() {
+            int64_t last = 0;
+            while( !done.load()) {
+                const int64_t now = encoder.getCount();
+                monotonic = monotonic && now >= last;
+                last = now;
+                reads++;
+            }
+        } );
+
+        struct timespec start, stop;
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        for( size_t ii = 0; ii < total; ii += batch ) {
+            encoder.process( &edges[ii], ii + batch <= total ? batch : total - ii );
+        }
+        clock_gettime( CLOCK_MONOTONIC, &stop );
+        done.store( true );
+        reader.join();
+
+        const double seconds = ( stop.tv_sec - start.tv_sec ) + ( stop.tv_nsec - start.tv_nsec ) * 1.0e-9;
+        std::cout << "Encoder: " << total << " edges, " << total / seconds / 1.0e6 << " M edges/s decoded, "
+                  << "rate " << encoder.getRate() << " counts/s, " << reads << " concurrent reads\n";
+        return monotonic && encoder.getCount() == static_cast<int64_t>( total ) &&
+               encoder.getErrors() == 0 && encoder.getRate() == 200000.0;
+    }
+
+    bool encoder_test( void ) {
+        std::cout << "Encoder test start\n";
+        bool success = true;
+        if( !testDirection()) {
+            std::cerr << "Encoder direction test failed.\n";
+            success = false;
+        }
+        if( !testErrors()) {
+            std::cerr << "Encoder error test failed.\n";
+            success = false;
+        }
+        if( !testCapture()) {
+            std::cerr << "Encoder capture test failed.\n";
+            success = false;
+        }
+        if( !testReader()) {
+            std::cerr << "Edge reader test failed.\n";
+            success = false;
+        }
+        if( !testStopped()) {
+            std::cerr << "Encoder stopped rate test failed.\n";
+            success = false;
+        }
+        if( !testPulses()) {
+            std::cerr << "Pulse counter test failed.\n";
+            success = false;
+        }
+        if( !benchmark()) {
+            std::cerr << "Encoder benchmark failed.\n";
+            success = false;
+        }
+        std::cout << "Encoder test " << ( success ? "complete" : "FAILED" ) << "\n";
+        return success;
+    }
+
+}   // namespace tfs
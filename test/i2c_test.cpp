@@ -0,0 +1,287 @@
+// ---------------------------------------------------------------------------
+//  i2c_test.cpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+// The I2C tests run against FakeI2cBus, which stands in for the i2c-dev driver
+// with a set of simple register-file devices. Like most sensors, a write sets
+// the register pointer and a read auto-increments it. In read-last mode the
+// fake refuses a read before the last message, as i2c-bcm2835 does.
+// ---------------------------------------------------------------------------
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "i2c.hpp"
+#include "tests.hpp"
+
+namespace  tfs  {
+
+    class FakeI2cBus : public I2cBus {
+    public:
+        struct Device {
+            uint8_t  registers[256];
+            uint8_t  pointer;
+            uint64_t reads;             // Bytes read from this device.
+        };
+        std::map<uint16_t, Device> m_devices;
+        bool     m_onlyReadLast;        // Behave like i2c-bcm2835.
+        uint64_t m_refused;             // Batches refused with EOPNOTSUPP.
+
+    protected:
+        virtual bool submit( struct i2c_msg *messages, size_t count ) {
+            if( count > I2C_RDWR_IOCTL_MAX_MSGS ) {
+                m_error = EINVAL;
+                return setStatus( STATUS_ERROR_IOCTL );
+            }
+            for( size_t ii = 0; m_onlyReadLast && ii + 1 < count; ii++ ) {
+                if( messages[ii].flags & I2C_M_RD ) {
+                    m_error = EOPNOTSUPP;           // Refused before anything goes on the bus.
+                    m_refused++;
+                    return setStatus( STATUS_ERROR_IOCTL );
+                }
+            }
+            for( size_t ii = 0; ii < count; ii++ ) {
+                const struct i2c_msg &msg = messages[ii];
+                std::map<uint16_t, Device>::iterator found = m_devices.find( msg.addr );
+                if( found == m_devices.end()) {
+                    m_error = ENXIO;                        // No ACK.
+                    return setStatus( STATUS_ERROR_IOCTL );
+                }
+                Device &device = found->second;
+                if( msg.flags & I2C_M_RD ) {
+                    for( size_t jj = 0; jj < msg.len; jj++ ) {
+                        msg.buf[jj] = device.registers[device.pointer++];
+                    }
+                    device.reads += msg.len;
+                } else if( msg.len > 0 ) {
+                    device.pointer = msg.buf[0];
+                    for( size_t jj = 1; jj < msg.len; jj++ ) {
+                        device.registers[device.pointer++] = msg.buf[jj];
+                    }
+                }
+            }
+            return setStatus( STATUS_OK );
+        }
+
+    public:
+        FakeI2cBus( bool onlyReadLast = false ):
+        I2cBus(),
+        m_onlyReadLast( onlyReadLast ),
+        m_refused( 0 ) {
+        }
+
+        void addDevice( uint16_t address ) {
+            Device &device = m_devices[address];
+            for( size_t ii = 0; ii < 256; ii++ ) {
+                device.registers[ii] = static_cast<uint8_t>( address + ii );
+            }
+            device.pointer = 0;
+            device.reads   = 0;
+        }
+    };
+
+    static const size_t   SENSORS       = 12;
+    static const uint16_t FIRST_SENSOR  = 0x40;
+    static const uint8_t  CONFIG_REG    = 0x00;  // Two configuration registers.
+    static const uint8_t  DATA_REG      = 0x10;  // Six bytes of sample data.
+
+    static bool testBatch( void ) {
+        // ---------------------------------------------------------------------------
+        // One cycle of a dozen sensors: the data from each in one ioctl, then
+        // config + data from each, which needs 48 messages and so two ioctls.
+        // ---------------------------------------------------------------------------
+        FakeI2cBus bus;
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            bus.addDevice( static_cast<uint16_t>( FIRST_SENSOR + ii ));
+        }
+        uint8_t config[SENSORS][2];
+        uint8_t data[SENSORS][6];
+        I2cRead reads[SENSORS * 2];
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            const uint16_t address = static_cast<uint16_t>( FIRST_SENSOR + ii );
+            reads[ii * 2]     = I2cRead( address, CONFIG_REG, config[ii], sizeof( config[ii] ));
+            reads[ii * 2 + 1] = I2cRead( address, DATA_REG,   data[ii],   sizeof( data[ii] ));
+        }
+        I2cRead samples[SENSORS];
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            samples[ii] = reads[ii * 2 + 1];
+        }
+        if( !bus.read( samples, SENSORS ) || bus.getIoctlCount() != 1 ) {
+            emitStatus( "i2c batch", bus.getStatus());
+            return false;
+        }
+        if( !bus.read( reads, SENSORS * 2 ) || bus.getIoctlCount() != 1 + 2 ) {
+            emitStatus( "i2c batch", bus.getStatus());
+            return false;
+        }
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            const uint8_t base = static_cast<uint8_t>( FIRST_SENSOR + ii );
+            if( config[ii][0] != base + CONFIG_REG || config[ii][1] != base + CONFIG_REG + 1 ||
+                data[ii][0]   != base + DATA_REG   || data[ii][5]   != base + DATA_REG + 5 ) {
+                std::cerr << "i2c batch data mismatch\n";
+                return false;
+            }
+        }
+        I2cRead twice[SENSORS * 4];
+        for( size_t ii = 0; ii < SENSORS * 4; ii++ ) {
+            twice[ii] = reads[ii % ( SENSORS * 2 )];
+        }
+        if( !bus.read( twice, SENSORS * 4 ) || bus.getIoctlCount() != 1 + 2 + 3 ) {
+            std::cerr << "i2c batch split failed\n";
+            return false;
+        }
+        return true;
+    }
+
+    static bool testReadLast( void ) {
+        // ---------------------------------------------------------------------------
+        // A controller that only takes a read as the last message refuses the
+        // first batch; it is resent one write-then-read per ioctl, and later
+        // batches are split up front.
+        // ---------------------------------------------------------------------------
+        FakeI2cBus bus( true );
+        uint8_t data[SENSORS][6];
+        I2cRead reads[SENSORS];
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            const uint16_t address = static_cast<uint16_t>( FIRST_SENSOR + ii );
+            bus.addDevice( address );
+            reads[ii] = I2cRead( address, DATA_REG, data[ii], sizeof( data[ii] ));
+        }
+        if( !bus.read( reads, SENSORS ) || !bus.getReadLast() || bus.m_refused != 1 ||
+            bus.getIoctlCount() != 1 + SENSORS ) {
+            emitStatus( "i2c read-last", bus.getStatus());
+            return false;
+        }
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            const uint8_t base = static_cast<uint8_t>( FIRST_SENSOR + ii );
+            if( data[ii][0] != base + DATA_REG || data[ii][5] != base + DATA_REG + 5 ||
+                bus.m_devices[FIRST_SENSOR + ii].reads != 6 ) {
+                std::cerr << "i2c read-last data mismatch\n";
+                return false;
+            }
+        }
+        if( !bus.read( reads, SENSORS ) || bus.m_refused != 1 || bus.getIoctlCount() != 1 + 2 * SENSORS ) {
+            return false;
+        }
+        const uint8_t  reg = DATA_REG;
+        const uint8_t  setting[2] = { CONFIG_REG, 0x33 };
+        uint8_t        back[2];
+        I2cTransaction mixed[2];                // A read in the middle, then a write.
+        mixed[0] = I2cTransaction( FIRST_SENSOR, &reg, 1, back, sizeof( back ));
+        mixed[1] = I2cTransaction( FIRST_SENSOR + 1, setting, sizeof( setting ), 0, 0 );
+        const uint64_t ioctls = bus.getIoctlCount();
+        return bus.transfer( mixed, 2 ) && bus.getIoctlCount() == ioctls + 2 &&
+               back[0] == FIRST_SENSOR + DATA_REG && bus.m_devices[FIRST_SENSOR + 1].registers[CONFIG_REG] == 0x33;
+    }
+
+    static bool testCache( void ) {
+        FakeI2cBus bus;
+        bus.addDevice( FIRST_SENSOR );
+        bus.enableCache( FIRST_SENSOR, CONFIG_REG, 2 );
+
+        const uint8_t setting[2] = { 0xA5, 0x5A };
+        if( !bus.writeRegisters( FIRST_SENSOR, CONFIG_REG, setting, 2 )) {
+            return false;
+        }
+        const uint64_t ioctls = bus.getIoctlCount();
+        uint8_t config[2] = { 0, 0 };
+        if( !bus.readRegisters( FIRST_SENSOR, CONFIG_REG, config, 2 ) ||
+            config[0] != 0xA5 || config[1] != 0x5A ||
+            bus.getIoctlCount() != ioctls || bus.getCacheHits() != 1 ) {
+            std::cerr << "i2c write-through cache failed\n";
+            return false;
+        }
+        // Reads that are not entirely cacheable go to the device.
+        uint8_t wide[3];
+        if( !bus.readRegisters( FIRST_SENSOR, CONFIG_REG, wide, 3 ) || bus.getIoctlCount() != ioctls + 1 ) {
+            std::cerr << "i2c partial cache read failed\n";
+            return false;
+        }
+        bus.invalidateCache( FIRST_SENSOR );
+        if( !bus.readRegisters( FIRST_SENSOR, CONFIG_REG, config, 2 ) || bus.getIoctlCount() != ioctls + 2 ) {
+            std::cerr << "i2c cache invalidate failed\n";
+            return false;
+        }
+        if( !bus.readRegisters( FIRST_SENSOR, CONFIG_REG, config, 2 ) || bus.getIoctlCount() != ioctls + 2 ) {
+            std::cerr << "i2c cache refill failed\n";
+            return false;
+        }
+        // A raw write through transfer() must not leave a stale shadow copy.
+        const uint8_t raw[2] = { CONFIG_REG, 0x77 };
+        const I2cTransaction write( FIRST_SENSOR, raw, sizeof( raw ), 0, 0 );
+        if( !bus.transfer( &write, 1 ) ||
+            !bus.readRegisters( FIRST_SENSOR, CONFIG_REG, config, 2 ) || config[0] != 0x77 ) {
+            std::cerr << "i2c cache not invalidated by transfer\n";
+            return false;
+        }
+        return true;
+    }
+
+    static bool testErrors( void ) {
+        FakeI2cBus bus;
+        bus.addDevice( FIRST_SENSOR );
+        uint8_t value = 0;
+        if( bus.readRegister( FIRST_SENSOR + 1, 0, value ) || bus.getStatus() != STATUS_ERROR_IOCTL ) {
+            return false;
+        }
+        if( bus.readRegisters( FIRST_SENSOR, 0, 0, 1 ) || bus.getStatus() != STATUS_INTERNAL_BAD_ARG ) {
+            return false;
+        }
+        if( bus.readRegister( 0x80, 0, value ) || bus.getStatus() != STATUS_INTERNAL_BAD_ARG ) {
+            return false;
+        }
+        return bus.readRegister( FIRST_SENSOR, 0, value ) && bus.ok();
+    }
+
+    static void benchmark( void ) {
+        // ---------------------------------------------------------------------------
+        // Compare one batched read per cycle against one call per register block.
+        // ---------------------------------------------------------------------------
+        FakeI2cBus bus;
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            bus.addDevice( static_cast<uint16_t>( FIRST_SENSOR + ii ));
+            bus.enableCache( static_cast<uint16_t>( FIRST_SENSOR + ii ), CONFIG_REG, 2 );
+        }
+        uint8_t config[SENSORS][2];
+        uint8_t data[SENSORS][6];
+        I2cRead reads[SENSORS * 2];
+        for( size_t ii = 0; ii < SENSORS; ii++ ) {
+            const uint16_t address = static_cast<uint16_t>( FIRST_SENSOR + ii );
+            reads[ii * 2]     = I2cRead( address, CONFIG_REG, config[ii], sizeof( config[ii] ));
+            reads[ii * 2 + 1] = I2cRead( address, DATA_REG,   data[ii],   sizeof( data[ii] ));
+        }
+        const size_t cycles = 10000;
+        for( size_t cc = 0; cc < cycles; cc++ ) {
+            bus.read( reads, SENSORS * 2 );
+        }
+        std::cout << "I2C batched: " << cycles << " cycles of " << SENSORS << " sensors, "
+                  << bus.getIoctlCount() << " ioctls, " << bus.getCacheHits() << " cache hits\n";
+        std::cout << "I2C one call per block would take " << cycles * SENSORS * 2 << " ioctls\n";
+    }
+
+    bool i2c_test( void ) {
+        std::cout << "I2C test start\n";
+        bool success = true;
+        if( !testBatch()) {
+            std::cerr << "I2C batch test failed.\n";
+            success = false;
+        }
+        if( !testReadLast()) {
+            std::cerr << "I2C read-last test failed.\n";
+            success = false;
+        }
+        if( !testCache()) {
+            std::cerr << "I2C cache test failed.\n";
+            success = false;
+        }
+        if( !testErrors()) {
+            std::cerr << "I2C error test failed.\n";
+            success = false;
+        }
+        benchmark();
+        std::cout << "I2C test " << ( success ? "complete" : "FAILED" ) << "\n";
+        return success;
+    }
+
+}   // namespace tfs
@@ -7,26 +7,36 @@
 #include <ctime>      // Needed for clock_gettime()
 #include <iostream>
 #include "gpio.hpp"
+#include "tests.hpp"
 
 namespace  tfs  {
     
-    void emitStatus( const char *label, Gpio &pin ) {
+    void emitStatus( const char *label, STATUS status ) {
         // ---------------------------------------------------------------------------
-        // Emit the status of the given GPIO pin object.
+        // Emit the given status.
         // ---------------------------------------------------------------------------
         std::cerr << label;
-        switch( pin.getStatus()) {
+        switch( status ) {
             case STATUS_OK:               std::cerr << " ok\n";                break;
             case STATUS_TIMEOUT:          std::cerr << " time out\n";          break;
             case STATUS_INTERNAL_BAD_ARG: std::cerr << " error: internal\n";   break;
             case STATUS_ERROR_FILE_OPEN:  std::cerr << " error: file open\n";  break;
             case STATUS_ERROR_FILE_SEEK:  std::cerr << " error: file seek\n";  break;
             case STATUS_ERROR_FILE_WRITE: std::cerr << " error: file write\n"; break;
-            case STATUS_ERROR_FILE_READ:  std::cerr << " error: file read\n";
+            case STATUS_ERROR_FILE_READ:  std::cerr << " error: file read\n";  break;
+            case STATUS_ERROR_IOCTL:      std::cerr << " error: ioctl\n";   break;
+            case STATUS_ERROR_NETWORK:    std::cerr << " error: network\n";
         }
         return;
     }
     
+    void emitStatus( const char *label, Gpio &pin ) {
+        // ---------------------------------------------------------------------------
+        // Emit the status of the given GPIO pin object.
+        // ---------------------------------------------------------------------------
+        emitStatus( label, pin.getStatus());
+    }
+    
     void testLoop( const GPIO_ID buttonPin, const GPIO_ID ledPin, const time_t maxTime ) {
         // ---------------------------------------------------------------------------
         // Set up an input pin & output pin.
@@ -150,7 +160,14 @@ int main( void ) {
     
     tfs::gpio_test();    // Run our simple GPIO tests above.
     
+    bool success = true;
+    success = tfs::spi_test() && success;   // SPI transfers against a loopback device, see spi_test.cpp
+    success = tfs::i2c_test() && success;   // I2C batches against stand-in devices, see i2c_test.cpp
+    success = tfs::decode_test() && success;    // Edge & protocol decoding, see decode_test.cpp
+    success = tfs::encoder_test() && success;   // Quadrature & pulse counting, see encoder_test.cpp
+    success = tfs::remote_test() && success;    // GPIO over UDP, see remote_test.cpp
+    
     std::cout << "GPIO tests complete\n";
-    return 0;
+    return success ? 0 : 1;
 }
 
@@ -0,0 +1,595 @@
+// ---------------------------------------------------------------------------
+//  remote_test.cpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+// RemoteGpio against a FakeGpioServer over loopback UDP. The fake keeps its
+// pin levels in memory, takes injected edges through a pipe, and can drop
+// replies or event datagrams to exercise retransmits. PinServer keeps the
+// server's own pin bookkeeping and only swaps the sysfs inputs for ones that
+// can be made to fail.
+// ---------------------------------------------------------------------------
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "remote.hpp"
+#include "tests.hpp"
+
+namespace  tfs  {
+
+    static const GPIO_ID PIN_OUT = GPIO_17;
+    static const GPIO_ID PIN_IN  = GPIO_22;
+
+    class FakeGpioServer : public GpioServer {
+    protected:
+        std::atomic<uint8_t>  m_levels[32];
+        std::atomic<uint8_t>  m_edgeSet[32];
+        int                   m_pipe[2];        // Injected edges: pin, level byte pairs.
+
+        virtual bool sendTo( const uint8_t *datagram, size_t length, const struct sockaddr_in &to ) {
+            std::atomic<int> &drop = datagram[3] == 3 ? dropEvents : dropReplies;  // 3: event datagram
+            if( drop.load() > 0 ) {
+                drop--;
+                return true;
+            }
+            return GpioServer::sendTo( datagram, length, to );
+        }
+
+        virtual STATUS pinWrite( GPIO_ID id, bool value ) {
+            m_levels[id].store( value ? 1 : 0 );
+            writes++;
+            return STATUS_OK;
+        }
+
+        virtual STATUS pinRead( GPIO_ID id, bool &value ) {
+            value = m_levels[id].load() != 0;
+            return STATUS_OK;
+        }
+
+        virtual STATUS pinSetEdge( GPIO_ID id, EDGE edge ) {
+            m_edgeSet[id].store( static_cast<uint8_t>( edge ));
+            return STATUS_OK;
+        }
+
+        virtual STATUS pinGetEdge( GPIO_ID id, EDGE &edge ) {
+            edge = static_cast<EDGE>( m_edgeSet[id].load());
+            return STATUS_OK;
+        }
+
+        virtual void edgeDescriptors( std::vector<struct pollfd> &fds ) {
+            struct pollfd fd;
+            fd.fd      = m_pipe[0];
+            fd.events  = POLLIN;
+            fd.revents = 0;
+            fds.push_back( fd );
+        }
+
+        virtual void edgeReady( const struct pollfd &fd ) {
+            uint8_t edge[2];
+            while( ::read( m_pipe[0], edge, 2 ) == 2 ) {
+                m_levels[edge[0]].store( edge[1] );
+                if( m_edgeSet[edge[0]].load() != EDGE_NONE ) {
+                    struct timespec now;
+                    clock_gettime( CLOCK_MONOTONIC, &now );
+                    pushEdge( static_cast<GPIO_ID>( edge[0] ), edge[1] != 0, now.tv_sec * 1000000000ull + now.tv_nsec );
+                }
+            }
+        }
+
+    public:
+        std::atomic<int>      dropReplies;
+        std::atomic<int>      dropEvents;
+        std::atomic<uint64_t> writes;
+
+        FakeGpioServer( void ):
+        GpioServer( 0 ),
+        dropReplies( 0 ),
+        dropEvents( 0 ),
+        writes( 0 ) {
+            for( int ii = 0; ii < 32; ii++ ) {
+                m_levels[ii].store( 0 );
+                m_edgeSet[ii].store( EDGE_NONE );
+            }
+            if( pipe( m_pipe ) != 0 ) {
+                setStatus( STATUS_ERROR_FILE_OPEN );
+                return;
+            }
+            fcntl( m_pipe[0], F_SETFL, O_NONBLOCK );
+        }
+
+        virtual ~FakeGpioServer( void ) {
+            ::close( m_pipe[0] );
+            ::close( m_pipe[1] );
+        }
+
+        bool level( GPIO_ID id ) const {
+            return m_levels[id].load() != 0;
+        }
+
+        EDGE edge( GPIO_ID id ) const {
+            return static_cast<EDGE>( m_edgeSet[id].load());
+        }
+
+        void injectEdge( GPIO_ID id, bool level ) {    // Safe from any thread.
+            const uint8_t edge[2] = { static_cast<uint8_t>( id ), static_cast<uint8_t>( level ? 1 : 0 ) };
+            if( ::write( m_pipe[1], edge, 2 ) != 2 ) {
+                std::cerr << "Remote test: edge inject failed.\n";
+            }
+        }
+    };
+
+    class PinServer : public GpioServer {
+    protected:
+        class Input : public GpioInput {        // No sysfs, fails on request.
+        protected:
+            PinServer &m_server;
+
+        public:
+            Input( PinServer &server, GPIO_ID id ):
+            GpioInput( id, -1 ),
+            m_server( server ) {
+            }
+
+            virtual bool setEdge( const EDGE edge ) {
+                if( m_server.failEdges.load()) {
+                    return setStatus( STATUS_ERROR_FILE_WRITE );
+                }
+                m_server.edges[m_id].store( static_cast<uint8_t>( edge ));
+                return setStatus( STATUS_OK );
+            }
+
+            virtual bool getEdge( EDGE &edge ) {
+                edge = static_cast<EDGE>( m_server.edges[m_id].load());
+                return setStatus( STATUS_OK );
+            }
+
+            virtual bool read( bool &value ) {
+                if( m_server.failReads.load()) {
+                    return setStatus( STATUS_ERROR_FILE_READ );
+                }
+                value = false;
+                return setStatus( STATUS_OK );
+            }
+        };
+
+        virtual GpioInput *openInput( GPIO_ID id ) {
+            return new Input( *this, id );
+        }
+
+    public:
+        std::atomic<bool>     failEdges;
+        std::atomic<bool>     failReads;
+        std::atomic<uint8_t>  edges[32];        // Last edge set on each input.
+
+        PinServer( void ):
+        GpioServer( 0 ),
+        failEdges( false ),
+        failReads( false ) {
+            for( int ii = 0; ii < 32; ii++ ) {
+                edges[ii].store( EDGE_NONE );
+            }
+        }
+    };
+
+    static bool testReadWrite( FakeGpioServer &server, RemoteGpio &remote ) {
+        RemoteGpioOutput output( remote, PIN_OUT );
+        if( !output.write( true ) || !server.level( PIN_OUT )) {
+            emitStatus( "Remote write", output.getStatus());
+            return false;
+        }
+        RemoteGpioInput input( remote, PIN_OUT );
+        bool value = false;
+        if( !input.read( value ) || !value ) {
+            return false;
+        }
+        RemoteGpioOutput bad( remote, static_cast<GPIO_ID>( 40 ));
+        return !bad.write( true ) && bad.getStatus() == STATUS_INTERNAL_BAD_ARG && remote.ok();
+    }
+
+    static bool testRetransmit( FakeGpioServer &server, RemoteGpio &remote ) {
+        // ---------------------------------------------------------------------------
+        // The first two replies are lost. The write must still run exactly once.
+        // ---------------------------------------------------------------------------
+        RemoteGpioOutput output( remote, PIN_OUT );
+        const uint64_t retransmits = remote.getStats().retransmits;
+        const uint64_t writes      = server.writes.load();
+        server.dropReplies.store( 2 );
+        if( !output.write( false ) || server.level( PIN_OUT )) {
+            emitStatus( "Remote retransmit", output.getStatus());
+            return false;
+        }
+        return remote.getStats().retransmits == retransmits + 2 && server.writes.load() == writes + 1;
+    }
+
+    static int openSocket( uint16_t port ) {
+        // A plain socket connected to the server, for hand made requests.
+        const int sock = socket( AF_INET, SOCK_DGRAM, 0 );
+        struct sockaddr_in address;
+        memset( &address, 0, sizeof( address ));
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        address.sin_port        = htons( port );
+        if( sock >= 0 && connect( sock, reinterpret_cast<struct sockaddr*>( &address ), sizeof( address )) < 0 ) {
+            ::close( sock );
+            return -1;
+        }
+        return sock;
+    }
+
+    static bool request( int sock, uint32_t sequence, REMOTE_OP code, GPIO_ID pin, uint8_t value, uint16_t session = 0 ) {
+        // One operation request, in the wire format described in remote.hpp.
+        const uint8_t datagram[16] = {
+            0x54, 0x47, 1, 1,                                   // Magic, version, request.
+            static_cast<uint8_t>( sequence ),       static_cast<uint8_t>( sequence >> 8 ),
+            static_cast<uint8_t>( sequence >> 16 ), static_cast<uint8_t>( sequence >> 24 ),
+            1, 0,                                               // One operation.
+            static_cast<uint8_t>( session ), static_cast<uint8_t>( session >> 8 ),
+            static_cast<uint8_t>( code ), static_cast<uint8_t>( pin ), value, 0
+        };
+        return send( sock, datagram, sizeof( datagram ), 0 ) == sizeof( datagram );
+    }
+
+    static bool awaitReply( int sock, uint32_t sequence, bool &stale ) {
+        // Wait for the reply to sequence, noting any reply to an older sequence.
+        uint8_t datagram[64];
+        struct pollfd fd;
+        fd.fd     = sock;
+        fd.events = POLLIN;
+        while( ::poll( &fd, 1, 500 ) > 0 ) {
+            if( recv( sock, datagram, sizeof( datagram ), 0 ) < 16 || datagram[3] != 2 ) {
+                continue;
+            }
+            const uint32_t seq = datagram[4] | ( datagram[5] << 8 ) | ( datagram[6] << 16 ) | ( static_cast<uint32_t>( datagram[7] ) << 24 );
+            if( seq == sequence ) {
+                return true;
+            }
+            stale = true;
+        }
+        return false;
+    }
+
+    static bool testReplay( FakeGpioServer &server ) {
+        // ---------------------------------------------------------------------------
+        // A delayed copy of request N that arrives after N+1 must not run again.
+        // Requests are sent from a plain socket so the copy can be replayed.
+        // Then the client restarts on the same port: a new session, whose lower
+        // sequence numbers are not mistaken for late copies.
+        // ---------------------------------------------------------------------------
+        const int sock = openSocket( server.getPort());
+        if( sock < 0 ) {
+            return false;
+        }
+        const uint32_t first  = 0xFFFFFFFE;                     // Wraps past 2^32 on the way.
+        const uint64_t writes = server.writes.load();
+        bool stale = false;
+        bool success = request( sock, first, REMOTE_OP_WRITE, GPIO_24, 1 ) && awaitReply( sock, first, stale ) &&
+                       request( sock, first + 2, REMOTE_OP_WRITE, GPIO_24, 0 ) && awaitReply( sock, first + 2, stale ) &&
+                       request( sock, first, REMOTE_OP_WRITE, GPIO_24, 1 ) &&        // The late copy.
+                       request( sock, first + 3, REMOTE_OP_READ, GPIO_24, 0 ) && awaitReply( sock, first + 3, stale );
+        success = success && !stale && !server.level( GPIO_24 ) && server.writes.load() == writes + 2;
+        success = success && request( sock, 1, REMOTE_OP_WRITE, GPIO_24, 1, 0x5a5a ) && awaitReply( sock, 1, stale ) &&
+                  server.level( GPIO_24 ) && server.writes.load() == writes + 3;
+        ::close( sock );
+        return success;
+    }
+
+    static bool testBatch( FakeGpioServer &server, RemoteGpio &remote ) {
+        RemoteGpioOutput a( remote, GPIO_05 );
+        RemoteGpioOutput b( remote, GPIO_06 );
+        RemoteGpioOutput c( remote, GPIO_13 );
+        const RemoteStats before = remote.getStats();
+        a.queue( true );
+        b.queue( true );
+        c.queue( true );
+        a.queue( false );                       // Replaces the first write to a.
+        if( remote.queued() != 3 || !remote.flush() || remote.queued() != 0 ) {
+            return false;
+        }
+        const RemoteStats &after = remote.getStats();
+        return after.roundTrips == before.roundTrips + 1 && after.operations == before.operations + 3 &&
+               after.coalesced  == before.coalesced  + 1 &&
+               !server.level( GPIO_05 ) && server.level( GPIO_06 ) && server.level( GPIO_13 );
+    }
+
+    static bool testEvents( FakeGpioServer &server, RemoteGpio &remote ) {
+        // ---------------------------------------------------------------------------
+        // Edges are pushed to the client, the first event datagram is lost and
+        // must be retransmitted. Each edge arrives once, in order.
+        // ---------------------------------------------------------------------------
+        RemoteGpioInput input( remote, PIN_IN );
+        EDGE edge = EDGE_NONE;
+        if( !input.setEdge( EDGE_BOTH ) || !input.getEdge( edge ) || edge != EDGE_BOTH ) {
+            return false;
+        }
+        const uint64_t events = remote.getStats().events;
+        server.dropEvents.store( 1 );
+        for( int ii = 0; ii < 5; ii++ ) {
+            server.injectEdge( PIN_IN, ( ii & 1 ) == 0 );
+        }
+        for( int ii = 0; ii < 5; ii++ ) {
+            bool value;
+            if( !input.read_wait( value, 1 ) || value != (( ii & 1 ) == 0 )) {
+                emitStatus( "Remote edge", input.getStatus());
+                return false;
+            }
+        }
+        bool value;
+        if( input.read_wait( value, 0, 100 ) || input.getStatus() != STATUS_TIMEOUT ) {
+            return false;                       // Nothing further, and no duplicates.
+        }
+        return remote.getStats().events == events + 5;
+    }
+
+    static bool testResubscribe( FakeGpioServer &server ) {
+        // ---------------------------------------------------------------------------
+        // Stop and start edges again. The server starts a new subscription, whose
+        // event sequence restarts; the client must not take it for retransmits.
+        // ---------------------------------------------------------------------------
+        const GPIO_ID pin = GPIO_21;
+        RemoteGpio client( "127.0.0.1", server.getPort());
+        RemoteGpioInput input( client, pin );
+        for( int round = 0; round < 2; round++ ) {
+            if(( round > 0 && !input.setEdge( EDGE_NONE )) || !input.setEdge( EDGE_BOTH )) {
+                return false;
+            }
+            for( int ii = 0; ii < 5; ii++ ) {
+                server.injectEdge( pin, ( ii & 1 ) == 0 );
+            }
+            for( int ii = 0; ii < 5; ii++ ) {
+                bool value;
+                if( !input.read_wait( value, 1 ) || value != (( ii & 1 ) == 0 )) {
+                    std::cerr << "Remote resubscribe: edge " << ii << " of round " << round << " missing.\n";
+                    return false;
+                }
+            }
+        }
+        return input.setEdge( EDGE_NONE );
+    }
+
+    static bool waitFor( FakeGpioServer &server, size_t subscribers, size_t clients ) {
+        for( int ii = 0; ii < 300; ii++ ) {
+            if( server.getSubscribers() == subscribers && server.getClients() <= clients ) {
+                return true;
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ));
+        }
+        return false;
+    }
+
+    static bool testSubscribers( FakeGpioServer &server ) {
+        // ---------------------------------------------------------------------------
+        // Two clients share a pin, each only sent the edges it asked for. One
+        // goes away without unsubscribing: it is dropped after the retries and
+        // its queued events are bounded meanwhile. Then idle clients expire.
+        // ---------------------------------------------------------------------------
+        const GPIO_ID pin    = GPIO_23;
+        const size_t  before = server.getSubscribers();
+        RemoteGpio live( "127.0.0.1", server.getPort());
+        RemoteGpioInput falling( live, pin );
+        if( !falling.setEdge( EDGE_FALLING ) || server.edge( pin ) != EDGE_FALLING ) {
+            return false;
+        }
+        {
+            RemoteGpio gone( "127.0.0.1", server.getPort());
+            RemoteGpioInput rising( gone, pin );
+            if( !rising.setEdge( EDGE_RISING ) || server.edge( pin ) != EDGE_BOTH ||
+                server.getSubscribers() != before + 2 ) {
+                return false;
+            }
+        }
+        const int rounds = 20;
+        const int edges  = 110;                                 // Per round, half of them falling.
+        for( int rr = 0; rr < rounds; rr++ ) {
+            for( int ii = 0; ii < edges; ii++ ) {
+                server.injectEdge( pin, ( ii & 1 ) == 0 );
+            }
+            for( int ii = 0; ii < edges / 2; ii++ ) {
+                bool value = true;
+                if( !falling.read_wait( value, 1 ) || value ) {
+                    emitStatus( "Remote shared edge", falling.getStatus());
+                    return false;
+                }
+            }
+        }
+        bool value;
+        if( falling.read_wait( value, 0, 50 )) {
+            return false;                                       // Rising edges are not sent to this client.
+        }
+        // rounds * edges / 2 rising edges for the client that went away, more than
+        // REMOTE_MAX_PENDING, so the oldest were dropped.
+        if( !waitFor( server, before + 1, 1000 ) || server.edge( pin ) != EDGE_FALLING || server.getDroppedEvents() == 0 ) {
+            std::cerr << "Remote dead client was not dropped: " << server.getSubscribers() << " subscribers\n";
+            return false;
+        }
+        return waitFor( server, before + 1, 0 );                // Everyone idle past the expiry.
+    }
+
+    static bool testFailedRead( PinServer &server, RemoteGpio &remote ) {
+        // ---------------------------------------------------------------------------
+        // Reads of an input with an edge armed fail. The server keeps serving the
+        // edge, and the input works again once the reads do.
+        // ---------------------------------------------------------------------------
+        RemoteGpioInput input( remote, GPIO_20 );
+        if( !input.setEdge( EDGE_BOTH )) {
+            emitStatus( "Remote pin edge", input.getStatus());
+            return false;
+        }
+        server.failReads.store( true );
+        bool value;
+        const bool failed = !input.read( value ) && !input.read( value );
+        server.failReads.store( false );
+        EDGE edge = EDGE_NONE;
+        if( !failed || !input.read( value ) || !input.getEdge( edge ) || edge != EDGE_BOTH || server.getSubscribers() != 1 ) {
+            return false;
+        }
+        return input.setEdge( EDGE_NONE ) && server.getSubscribers() == 0;
+    }
+
+    static bool testFailedUnsubscribe( PinServer &server, RemoteGpio &remote ) {
+        // ---------------------------------------------------------------------------
+        // The pin cannot be changed while a client stops, or while the server drops
+        // the subscriptions of a restarted client. The client is forgotten anyway,
+        // so the pin is left with only the edges other clients want.
+        // ---------------------------------------------------------------------------
+        const GPIO_ID pin = GPIO_16;
+        RemoteGpioInput input( remote, pin );
+        {
+            RemoteGpio other( "127.0.0.1", server.getPort());
+            RemoteGpioInput stopping( other, pin );
+            if( !stopping.setEdge( EDGE_RISING ) || server.getSubscribers() != 1 ) {
+                return false;
+            }
+            server.failEdges.store( true );
+            const bool refused = !stopping.setEdge( EDGE_NONE );
+            server.failEdges.store( false );
+            if( !refused || server.getSubscribers() != 0 ) {
+                return false;
+            }
+        }
+        if( !input.setEdge( EDGE_FALLING ) || server.edges[pin].load() != EDGE_FALLING ) {
+            return false;
+        }
+        const int sock = openSocket( server.getPort());
+        bool stale = false;
+        bool success = sock >= 0 &&
+                       request( sock, 1, REMOTE_OP_SET_EDGE, pin, EDGE_RISING, 1 ) && awaitReply( sock, 1, stale ) &&
+                       server.edges[pin].load() == EDGE_BOTH && server.getSubscribers() == 2;
+        server.failEdges.store( true );
+        success = success && request( sock, 1, REMOTE_OP_READ, pin, 0, 2 ) && awaitReply( sock, 1, stale );   // Restarted.
+        server.failEdges.store( false );
+        if( sock >= 0 ) {
+            ::close( sock );
+        }
+        if( !success || server.getSubscribers() != 1 ) {
+            return false;
+        }
+        if( !input.setEdge( EDGE_NONE ) || !input.setEdge( EDGE_FALLING ) || server.edges[pin].load() != EDGE_FALLING ) {
+            return false;                       // Unsubscribe & resubscribe, with nobody else on the pin.
+        }
+        return input.setEdge( EDGE_NONE ) && server.getSubscribers() == 0 && server.edges[pin].load() == EDGE_NONE;
+    }
+
+    static bool pin_test( void ) {
+        PinServer server;
+        if( !server.ok()) {
+            emitStatus( "Remote pin server", server.getStatus());
+            return false;
+        }
+        std::thread thread( [&]() { server.run(); } );
+        RemoteGpio remote( "127.0.0.1", server.getPort());
+        remote.setTimeout( 20, 3 );
+        bool success = remote.ok();
+        if( success && !testFailedRead( server, remote )) {
+            std::cerr << "Remote failed read test failed.\n";
+            success = false;
+        }
+        if( success && !testFailedUnsubscribe( server, remote )) {
+            std::cerr << "Remote failed unsubscribe test failed.\n";
+            success = false;
+        }
+        server.stop();
+        thread.join();
+        return success;
+    }
+
+    static bool benchmark( RemoteGpio &remote ) {
+        // ---------------------------------------------------------------------------
+        // Round trip time for single writes, and write throughput when each
+        // round trip carries a full batch of REMOTE_MAX_OPS.
+        // ---------------------------------------------------------------------------
+        const int rounds = 2000;
+        RemoteGpioOutput output( remote, PIN_OUT );
+        struct timespec start, stop;
+        const RemoteStats before = remote.getStats();
+        for( int ii = 0; ii < rounds; ii++ ) {
+            if( !output.write(( ii & 1 ) != 0 )) {
+                return false;
+            }
+        }
+        const double rtt = static_cast<double>( remote.getStats().nanoseconds - before.nanoseconds ) / rounds;
+
+        std::vector<RemoteOp> ops;
+        for( size_t ii = 0; ii < REMOTE_MAX_OPS; ii++ ) {
+            ops.push_back( RemoteOp( REMOTE_OP_WRITE, static_cast<GPIO_ID>( GPIO_02 + ii % 26 ), ii & 1 ));
+        }
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        for( int ii = 0; ii < rounds; ii++ ) {
+            if( !remote.transfer( &ops[0], ops.size())) {
+                return false;
+            }
+        }
+        clock_gettime( CLOCK_MONOTONIC, &stop );
+        const double seconds = ( stop.tv_sec - start.tv_sec ) + ( stop.tv_nsec - start.tv_nsec ) * 1.0e-9;
+        std::cout << "Remote: " << rtt / 1000.0 << " us per round trip, "
+                  << rounds * ops.size() / seconds / 1.0e6 << " M ops/s in batches of " << ops.size()
+                  << ", " << 1.0 / rtt * 1.0e3 << " M ops/s unbatched\n";
+        return true;
+    }
+
+    bool remote_test( void ) {
+        std::cout << "Remote test start\n";
+        FakeGpioServer server;
+        if( !server.ok()) {
+            emitStatus( "Remote server", server.getStatus());
+            return false;
+        }
+        server.setEventRetransmit( 20, 25 );   // Give up on a silent client within half a second.
+        server.setExpiry( 500 );
+        std::thread thread( [&]() { server.run(); } );
+        RemoteGpio remote( "127.0.0.1", server.getPort());
+        remote.setTimeout( 20, 3 );
+        bool success = remote.ok();
+        if( !success ) {
+            emitStatus( "Remote client", remote.getStatus());
+        }
+        if( success && !testReadWrite( server, remote )) {
+            std::cerr << "Remote read/write test failed.\n";
+            success = false;
+        }
+        if( success && !testRetransmit( server, remote )) {
+            std::cerr << "Remote retransmit test failed.\n";
+            success = false;
+        }
+        if( success && !testReplay( server )) {
+            std::cerr << "Remote replay test failed.\n";
+            success = false;
+        }
+        if( success && !testBatch( server, remote )) {
+            std::cerr << "Remote batch test failed.\n";
+            success = false;
+        }
+        if( success && !testEvents( server, remote )) {
+            std::cerr << "Remote event test failed.\n";
+            success = false;
+        }
+        if( success && !testResubscribe( server )) {
+            std::cerr << "Remote resubscribe test failed.\n";
+            success = false;
+        }
+        if( success && !testSubscribers( server )) {
+            std::cerr << "Remote subscriber test failed.\n";
+            success = false;
+        }
+        if( success && !pin_test()) {
+            success = false;
+        }
+        if( success && !benchmark( remote )) {
+            std::cerr << "Remote benchmark failed.\n";
+            success = false;
+        }
+        server.stop();
+        thread.join();
+        std::cout << "Remote test " << ( success ? "complete" : "FAILED" ) << "\n";
+        return success;
+    }
+
+}   // namespace tfs
@@ -0,0 +1,217 @@
+// ---------------------------------------------------------------------------
+//  spi_test.cpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+// The SPI tests run against LoopbackSpiDevice, which stands in for the spidev
+// driver and echoes MOSI back on MISO. If /dev/spidev0.0 exists and MOSI
+// (GPIO_10, PIN_19) is jumpered to MISO (GPIO_09, PIN_21) the same loopback
+// check is run against the real hardware.
+// ---------------------------------------------------------------------------
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "spi.hpp"
+#include "tests.hpp"
+
+namespace  tfs  {
+
+    class LoopbackSpiDevice : public SpiDevice {
+    public:
+        size_t   m_submits;                 // Number of ioctl equivalents.
+        bool     m_counting;                // Answer each transfer with a frame number instead of the echo.
+        uint32_t m_frame;
+        long     m_microseconds;            // Time each message takes on the wire.
+
+    protected:
+        virtual bool submit( struct spi_ioc_transfer *transfers, size_t count ) {
+            // Echo each transfer's tx into its rx, zeros when there is no tx.
+            for( size_t ii = 0; ii < count; ii++ ) {
+                const struct spi_ioc_transfer &xfer = transfers[ii];
+                uint8_t       *rx = reinterpret_cast<uint8_t*>( static_cast<uintptr_t>( xfer.rx_buf ));
+                const uint8_t *tx = reinterpret_cast<const uint8_t*>( static_cast<uintptr_t>( xfer.tx_buf ));
+                if( rx == 0 ) {
+                    continue;
+                }
+                if( m_counting ) {
+                    memset( rx, 0, xfer.len );
+                    for( size_t byte = 0; byte < xfer.len && byte < 4; byte++ ) {
+                        rx[byte] = static_cast<uint8_t>( m_frame >> ( 8 * byte ));
+                    }
+                    m_frame++;
+                } else if( tx == 0 ) {
+                    memset( rx, 0, xfer.len );
+                } else {
+                    memcpy( rx, tx, xfer.len );
+                }
+            }
+            m_submits++;
+            if( m_microseconds > 0 ) {
+                std::this_thread::sleep_for( std::chrono::microseconds( m_microseconds ));
+            }
+            return setStatus( STATUS_OK );
+        }
+
+    public:
+        LoopbackSpiDevice( void ):
+        SpiDevice(),
+        m_submits( 0 ),
+        m_counting( false ),
+        m_frame( 0 ),
+        m_microseconds( 0 ) {
+        }
+    };
+
+    static bool testSegments( SpiDevice &device, const char *label ) {
+        // ---------------------------------------------------------------------------
+        // Three segments in one message: command, dummy, read back.
+        // ---------------------------------------------------------------------------
+        const uint8_t command[3] = { 0x01, 0x80, 0x00 };
+        const uint8_t pattern[4] = { 0xDE, 0xAD, 0xBE, 0xEF };
+        uint8_t       reply[3]   = { 0xFF, 0xFF, 0xFF };
+        uint8_t       echo[4]    = { 0, 0, 0, 0 };
+        uint8_t       zeros[2]   = { 0xFF, 0xFF };
+
+        SpiSegment segments[3];
+        segments[0] = SpiSegment( command, reply, sizeof( command ), true );
+        segments[1] = SpiSegment( 0,       zeros, sizeof( zeros ));
+        segments[2] = SpiSegment( pattern, echo,  sizeof( pattern ));
+
+        if( !device.transfer( segments, 3 )) {
+            emitStatus( label, device.getStatus());
+            return false;
+        }
+        if( memcmp( reply, command, sizeof( command )) != 0 ||
+            memcmp( echo,  pattern, sizeof( pattern )) != 0 ||
+            zeros[0] != 0 || zeros[1] != 0 ) {
+            std::cerr << label << " loopback data mismatch\n";
+            return false;
+        }
+        return true;
+    }
+
+    static bool testStream( void ) {
+        // ---------------------------------------------------------------------------
+        // Continuous sampling of an MCP3008 style 3 byte frame into a ring,
+        // with a consumer thread draining it. Each frame carries its number, so
+        // the consumer sees them in order, many times around the ring, with gaps
+        // only where the ring overran. A message is cut short where it would
+        // wrap the ring, so the frame count is taken from the device.
+        // ---------------------------------------------------------------------------
+        const uint8_t  command[3]       = { 0x01, 0x80, 0x00 };
+        const size_t   framesPerMessage = 64;
+        const uint64_t messages         = 2000;
+
+        LoopbackSpiDevice device;
+        device.m_counting     = true;
+        device.m_microseconds = 50;             // 64 frames at about 4 MHz.
+        SpiRing           ring( sizeof( command ), 1000 );  // Not a multiple of the message size.
+        bool              producerOk = false;
+        std::atomic<bool> done( false );
+
+        std::thread producer( [&]() {
+            producerOk = device.stream( command, framesPerMessage, ring, messages );
+            done.store( true );
+        } );
+
+        size_t  received = 0;
+        bool    ordered  = true;
+        int64_t last     = -1;
+        uint8_t frame[3];
+        bool    finished = false;
+        while( !finished ) {
+            finished = done.load();             // Drain once more after the producer is done.
+            while( ring.read( frame )) {
+                const int64_t number = frame[0] | ( frame[1] << 8 ) | ( frame[2] << 16 );
+                ordered = ordered && number > last;
+                last    = number;
+                received++;
+            }
+            std::this_thread::yield();
+        }
+        producer.join();
+
+        const SpiStats &stats = device.getStats();
+        std::cout << "SPI stream: " << stats.messages << " messages, "
+                  << received << " frames received, " << ring.overruns() << " overruns, "
+                  << stats.bytesPerSecond() / 1.0e6 << " MB/s through the timed memcpy stand-in, "
+                  << stats.averageLatency() << " ns/message (min " << stats.minNanoseconds
+                  << ", max " << stats.maxNanoseconds << ")\n";
+
+        if( !producerOk || !ordered || device.m_submits != messages ||
+            received < 2 * ring.capacity() || last != static_cast<int64_t>( device.m_frame ) - 1 ||
+            received + ring.overruns() != device.m_frame ) {
+            std::cerr << "SPI stream failed.\n";
+            return false;
+        }
+        return true;
+    }
+
+    static bool testStopFirst( void ) {
+        // ---------------------------------------------------------------------------
+        // A stop() made before the stream thread starts must still end the stream.
+        // ---------------------------------------------------------------------------
+        const uint8_t command[3] = { 0x01, 0x80, 0x00 };
+        LoopbackSpiDevice device;
+        SpiRing ring( sizeof( command ), 64 );
+        device.stop();
+        std::thread producer( [&]() {
+            device.stream( command, 8, ring, 0 );
+        } );
+        producer.join();
+        return device.m_submits == 0 && !device.streaming();
+    }
+
+    static bool testBadArgs( void ) {
+        LoopbackSpiDevice device;
+        SpiSegment segment;
+        if( device.transfer( &segment, 0 ) || device.getStatus() != STATUS_INTERNAL_BAD_ARG ) {
+            return false;
+        }
+        device.clearStatus();
+        if( device.transfer( &segment, SPI_MAX_SEGMENTS + 1 ) || device.getStatus() != STATUS_INTERNAL_BAD_ARG ) {
+            return false;
+        }
+        return device.m_submits == 0;
+    }
+
+    bool spi_test( void ) {
+        std::cout << "SPI test start\n";
+        bool success = true;
+
+        LoopbackSpiDevice loopback;
+        if( !testSegments( loopback, "spi loopback" ) || loopback.m_submits != 1 ) {
+            std::cerr << "SPI segment test failed.\n";
+            success = false;
+        }
+        if( !testBadArgs()) {
+            std::cerr << "SPI bad argument test failed.\n";
+            success = false;
+        }
+        if( !testStream()) {
+            success = false;
+        }
+        if( !testStopFirst()) {
+            std::cerr << "SPI stop before stream test failed.\n";
+            success = false;
+        }
+
+        SpiDevice hardware( 0, 0 );             // /dev/spidev0.0, needs MOSI jumpered to MISO.
+        if( hardware.ok()) {
+            if( testSegments( hardware, "spidev0.0" )) {
+                std::cout << "spidev0.0 loopback ok\n";
+            } else {
+                std::cerr << "spidev0.0 loopback failed, is MOSI jumpered to MISO?\n";
+                success = false;
+            }
+        } else {
+            std::cout << "spidev0.0 not available, hardware loopback skipped\n";
+        }
+
+        std::cout << "SPI test " << ( success ? "complete" : "FAILED" ) << "\n";
+        return success;
+    }
+
+}   // namespace tfs
@@ -0,0 +1,24 @@
+// ---------------------------------------------------------------------------
+//  tests.hpp
+//
+//  Created by Barrett Davis on 10/12/16.
+//  Copyright © 2016 Tree Frog Software. All rights reserved.
+// ---------------------------------------------------------------------------
+#ifndef tests_hpp
+#define tests_hpp
+
+#include "gpio.hpp"
+
+namespace  tfs  {
+
+    void emitStatus( const char *label, STATUS status );   // main.cpp
+
+    bool spi_test( void );                                  // spi_test.cpp
+    bool i2c_test( void );                                  // i2c_test.cpp
+    bool decode_test( void );                               // decode_test.cpp
+    bool encoder_test( void );                              // encoder_test.cpp
+    bool remote_test( void );                               // remote_test.cpp
+
+}   // namespace tfs
+
+#endif // tests_hpp